@@ -0,0 +1,170 @@
+#pragma once
+
+#include "InputModule.hxx"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
+
+namespace framework
+{
+
+/// @brief Retained black and white framebuffer for the B1 Display
+///
+/// The frame is drawn locally and only the columns that differ from what the device displays are sent with
+/// SetPxColor when presenting it, followed by a single FlushFB.
+class B1DisplayFramebuffer
+{
+public:
+    static constexpr int Width = 300;
+    static constexpr int Height = 400;
+    /// Bytes used by a column in SetPxColor
+    static constexpr std::size_t ColumnSize = Height / 8;
+
+    /// A column packed 1 bit per pixel, from the top, least significant bit first
+    ///
+    /// Padded to 64 bytes so that columns are compared a full vector at a time, the padding is always zero
+    using Column = std::array<uint8_t, 64>;
+    static_assert(ColumnSize <= sizeof(Column));
+    static_assert(ColumnSize == sizeof(Commands::SetPxColor::ColorData));
+
+public:
+    /// @param Module The B1 Display to draw on. The pointer is not owned and must outlive the framebuffer
+    explicit B1DisplayFramebuffer(IInputModule* Module): Module(Module), Pixels(Width), Displayed(Width)
+    {
+    }
+
+    /// Turn one pixel on or off
+    void SetPixel(int X, int Y, bool bOn)
+    {
+        INPUTMODULE_ASSERT(X >= 0 && X < Width && Y >= 0 && Y < Height);
+        uint8_t& Byte = Pixels[X][Y / 8];
+        const uint8_t Mask = 1 << (Y % 8);
+        Byte = bOn ? (Byte | Mask) : (Byte & ~Mask);
+    }
+
+    bool GetPixel(int X, int Y) const
+    {
+        INPUTMODULE_ASSERT(X >= 0 && X < Width && Y >= 0 && Y < Height);
+        return Pixels[X][Y / 8] & (1 << (Y % 8));
+    }
+
+    /// Replace a whole packed column
+    void SetColumn(int X, std::span<const uint8_t, ColumnSize> Data)
+    {
+        INPUTMODULE_ASSERT(X >= 0 && X < Width);
+        std::memcpy(Pixels[X].data(), Data.data(), ColumnSize);
+    }
+
+    /// Turn every pixel on or off
+    void Fill(bool bOn)
+    {
+        for (Column& Col: Pixels) {
+            std::memset(Col.data(), bOn ? 0xFF : 0x00, ColumnSize);
+        }
+    }
+
+    /// Forget what the device is displaying, the next Present will redraw the whole frame
+    void Invalidate()
+    {
+        bDisplayedValid = false;
+    }
+
+    /// Send the columns that changed to the device and display them
+    ///
+    /// @return The number of bytes written to the device (0 if the frame was already displayed), -1 on error.
+    /// On error the device state is unknown and the next Present redraws the whole frame
+    int Present()
+    {
+        if (Module == nullptr) {
+            return -1;
+        }
+
+        // Commands are sent in batches, the last one carrying the FlushFB
+        constexpr std::size_t BatchSize = 32;
+        Commands::SetPxColor SetCommands[BatchSize];
+        const Commands::FlushFB FlushCommand;
+        std::array<std::span<const uint8_t>, BatchSize + 1> Buffers;
+
+        int Written = 0;
+        std::size_t BufferCount = 0;
+        bool bChanged = false;
+        for (int X = 0; X < Width; X++) {
+            if (bDisplayedValid && IsSameColumn(Pixels[X], Displayed[X])) {
+                continue;
+            }
+            bChanged = true;
+
+            if (BufferCount == BatchSize) {
+                const int Result = Module->WriteBatchToDevice(std::span(Buffers.data(), BufferCount));
+                if (Result < 0) {
+                    Invalidate();
+                    return -1;
+                }
+                Written += Result;
+                BufferCount = 0;
+            }
+
+            Commands::SetPxColor& Command = SetCommands[BufferCount];
+            Command.SetColumn(static_cast<uint16_t>(X));
+            std::memcpy(Command.ColorData, Pixels[X].data(), ColumnSize);
+            Buffers[BufferCount++] = AsPayloadBytes(Command);
+        }
+        if (!bChanged) {
+            return 0;
+        }
+
+        Buffers[BufferCount++] = AsPayloadBytes(FlushCommand);
+        const int Result = Module->WriteBatchToDevice(std::span(Buffers.data(), BufferCount));
+        if (Result < 0) {
+            Invalidate();
+            return -1;
+        }
+
+        Displayed = Pixels;
+        bDisplayedValid = true;
+        return Written + Result;
+    }
+
+private:
+    static bool IsSameColumn(const Column& A, const Column& B)
+    {
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128i Difference = _mm_setzero_si128();
+        for (std::size_t Offset = 0; Offset < sizeof(Column); Offset += 16) {
+            const __m128i ValueA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(A.data() + Offset));
+            const __m128i ValueB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(B.data() + Offset));
+            Difference = _mm_or_si128(Difference, _mm_xor_si128(ValueA, ValueB));
+        }
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(Difference, _mm_setzero_si128())) == 0xFFFF;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        uint8x16_t Difference = vdupq_n_u8(0);
+        for (std::size_t Offset = 0; Offset < sizeof(Column); Offset += 16) {
+            Difference = vorrq_u8(Difference, veorq_u8(vld1q_u8(A.data() + Offset), vld1q_u8(B.data() + Offset)));
+        }
+        return vmaxvq_u8(Difference) == 0;
+#else
+        return std::memcmp(A.data(), B.data(), sizeof(Column)) == 0;
+#endif
+    }
+
+private:
+    IInputModule* const Module = nullptr;
+
+    /// Frame being drawn
+    std::vector<Column> Pixels;
+    /// Frame currently displayed by the device
+    std::vector<Column> Displayed;
+
+    bool bDisplayedValid = false;
+};
+
+}    // namespace framework
@@ -0,0 +1,373 @@
+#pragma once
+
+#include "InputModule.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+namespace framework
+{
+
+enum class PixelFormat {
+    Gray8,    /// 1 byte per pixel
+    RGBA8,    /// 4 bytes per pixel, red first
+};
+
+/// @brief Non-owning view over an image in memory
+struct ImageView {
+    const uint8_t* Data = nullptr;
+    int Width = 0;
+    int Height = 0;
+    /// Bytes between the start of two rows
+    std::size_t Stride = 0;
+    PixelFormat Format = PixelFormat::Gray8;
+};
+
+enum class DitherMode {
+    None,              /// Plain threshold
+    Ordered,           /// 8x8 Bayer matrix
+    ErrorDiffusion,    /// Floyd-Steinberg
+};
+
+/// @brief Settings of an image conversion
+struct ImageConversionSettings {
+    /// Gamma applied to the luma, the LED are linear so 2.2 matches how a screen would display the image
+    float Gamma = 2.2f;
+    /// Multiplier applied after the gamma
+    float Brightness = 1.0f;
+    /// How the image is turned black and white for DrawBW
+    DitherMode Dither = DitherMode::Ordered;
+    /// Luma above which a pixel is on, when not dithering
+    uint8_t Threshold = 128;
+};
+
+/// @brief Convert images to the payloads of the LED Matrix
+///
+/// The image is downsampled to the 9x34 grid of the LED Matrix by averaging the luma of the pixels covered by each
+/// LED, then goes through the gamma / brightness curve and is written straight into the payload. Summing the luma is
+/// the only part that scales with the size of the image, it is vectorized with AVX2, SSE2 or NEON depending on the
+/// compilation flags.
+class ImageConverter
+{
+public:
+    static constexpr int Width = 9;
+    static constexpr int Height = 34;
+
+public:
+    explicit ImageConverter(const ImageConversionSettings& Settings = {}): Settings(Settings)
+    {
+        for (int Value = 0; Value < 256; Value++) {
+            const float Corrected = std::pow(Value / 255.0f, Settings.Gamma) * Settings.Brightness * 255.0f;
+            Curve[Value] = static_cast<uint8_t>(std::clamp(std::lround(Corrected), 0l, 255l));
+        }
+    }
+
+    /// Fill the grayscale columns of the LED Matrix, to be sent with StageCol then FlushCol
+    void ToStageCols(const ImageView& Image, std::span<Commands::StageCol, Width> Columns) const
+    {
+        for (int X = 0; X < Width; X++) {
+            Columns[X].Col = static_cast<uint8_t>(X);
+        }
+        Downsample(Image, [&Columns](int X, int Y, uint8_t Value) { Columns[X].Data[Y] = Value; });
+    }
+
+    /// Fill a black and white image of the LED Matrix, dithered according to the settings
+    void ToDrawBW(const ImageView& Image, Commands::DrawBW& Command) const
+    {
+        std::fill(std::begin(Command.Data), std::end(Command.Data), 0);
+
+        // Floyd-Steinberg error of the current and next rows, with a guard on both sides
+        std::array<std::array<int16_t, Width + 2>, 2> Error = {};
+
+        Downsample(Image, [this, &Command, &Error](int X, int Y, uint8_t Value) {
+            bool bOn = false;
+            switch (Settings.Dither) {
+                case DitherMode::None: bOn = Value >= Settings.Threshold; break;
+                case DitherMode::Ordered: bOn = Value > BayerMatrix[Y % 8][X % 8] * 4 + 2; break;
+                case DitherMode::ErrorDiffusion: {
+                    std::array<int16_t, Width + 2>& Current = Error[Y % 2];
+                    std::array<int16_t, Width + 2>& Next = Error[(Y + 1) % 2];
+                    if (X == 0) {
+                        Next.fill(0);
+                    }
+
+                    const int Wanted = Value + Current[X + 1];
+                    bOn = Wanted >= 128;
+                    const int Residual = Wanted - (bOn ? 255 : 0);
+                    Current[X + 2] += Residual * 7 / 16;
+                    Next[X] += Residual * 3 / 16;
+                    Next[X + 1] += Residual * 5 / 16;
+                    Next[X + 2] += Residual / 16;
+                    break;
+                }
+            }
+
+            // Pixels are packed row by row, least significant bit first
+            if (bOn) {
+                const int Index = Y * Width + X;
+                Command.Data[Index / 8] |= 1 << (Index % 8);
+            }
+        });
+    }
+
+private:
+    /// Average the image over the LED Matrix grid, giving each value to the sink in row order
+    template <typename SinkType>
+    void Downsample(const ImageView& Image, SinkType&& Sink) const
+    {
+        INPUTMODULE_ASSERT(Image.Data != nullptr && Image.Width > 0 && Image.Height > 0);
+        const int BytesPerPixel = Image.Format == PixelFormat::RGBA8 ? 4 : 1;
+
+        // Every LED covers at least one pixel, even if the image is smaller than the grid
+        std::array<int, Width + 1> ColumnStart;
+        for (int X = 0; X <= Width; X++) {
+            ColumnStart[X] = X * Image.Width / Width;
+        }
+
+        for (int Y = 0; Y < Height; Y++) {
+            const int RowStart = Y * Image.Height / Height;
+            const int RowEnd = std::max(RowStart + 1, (Y + 1) * Image.Height / Height);
+
+            // Luma multiplied by 256
+            std::array<uint64_t, Width> Sums = {};
+            for (int Row = RowStart; Row < RowEnd; Row++) {
+                const uint8_t* const RowData = Image.Data + Row * Image.Stride;
+                for (int X = 0; X < Width; X++) {
+                    const int Count = std::max(1, ColumnStart[X + 1] - ColumnStart[X]);
+                    const uint8_t* const Pixels = RowData + ColumnStart[X] * BytesPerPixel;
+                    Sums[X] += Image.Format == PixelFormat::RGBA8 ? SumLumaRGBA8(Pixels, Count)
+                                                                   : SumLumaGray8(Pixels, Count);
+                }
+            }
+
+            for (int X = 0; X < Width; X++) {
+                const uint64_t Count = uint64_t(std::max(1, ColumnStart[X + 1] - ColumnStart[X])) * (RowEnd - RowStart);
+                const uint64_t Average = (Sums[X] + Count * 128) / (Count * 256);
+                Sink(X, Y, Curve[std::min<uint64_t>(Average, 255)]);
+            }
+        }
+    }
+
+    /// Sum of a run of gray pixels, multiplied by 256
+    static uint64_t SumLumaGray8(const uint8_t* Data, int Count)
+    {
+        uint64_t Sum = 0;
+        int Index = 0;
+#if defined(__AVX2__)
+        __m256i Accumulator = _mm256_setzero_si256();
+        for (; Index + 32 <= Count; Index += 32) {
+            const __m256i Values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Data + Index));
+            Accumulator = _mm256_add_epi64(Accumulator, _mm256_sad_epu8(Values, _mm256_setzero_si256()));
+        }
+        alignas(32) uint64_t Lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(Lanes), Accumulator);
+        Sum = Lanes[0] + Lanes[1] + Lanes[2] + Lanes[3];
+#elif defined(__SSE2__) || defined(_M_X64)
+        __m128i Accumulator = _mm_setzero_si128();
+        for (; Index + 16 <= Count; Index += 16) {
+            const __m128i Values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + Index));
+            Accumulator = _mm_add_epi64(Accumulator, _mm_sad_epu8(Values, _mm_setzero_si128()));
+        }
+        alignas(16) uint64_t Lanes[2];
+        _mm_store_si128(reinterpret_cast<__m128i*>(Lanes), Accumulator);
+        Sum = Lanes[0] + Lanes[1];
+#elif defined(__ARM_NEON)
+        uint32x4_t Accumulator = vdupq_n_u32(0);
+        for (; Index + 16 <= Count; Index += 16) {
+            Accumulator = vpadalq_u16(Accumulator, vpaddlq_u8(vld1q_u8(Data + Index)));
+        }
+        Sum = uint64_t(vgetq_lane_u32(Accumulator, 0)) + vgetq_lane_u32(Accumulator, 1) +
+              vgetq_lane_u32(Accumulator, 2) + vgetq_lane_u32(Accumulator, 3);
+#endif
+        for (; Index < Count; Index++) {
+            Sum += Data[Index];
+        }
+        return Sum * 256;
+    }
+
+    /// Sum of the luma of a run of RGBA pixels (BT.601, weights of 77 / 150 / 29), multiplied by 256
+    static uint64_t SumLumaRGBA8(const uint8_t* Data, int Count)
+    {
+        uint64_t Sum = 0;
+        int Index = 0;
+#if defined(__AVX2__)
+        const __m256i Weights = _mm256_set1_epi64x(0x0000001D0096004D);
+        __m256i Accumulator = _mm256_setzero_si256();
+        for (; Index + 8 <= Count; Index += 8) {
+            const __m256i Values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Data + Index * 4));
+            const __m256i Low = _mm256_unpacklo_epi8(Values, _mm256_setzero_si256());
+            const __m256i High = _mm256_unpackhi_epi8(Values, _mm256_setzero_si256());
+            Accumulator = _mm256_add_epi32(Accumulator, _mm256_madd_epi16(Low, Weights));
+            Accumulator = _mm256_add_epi32(Accumulator, _mm256_madd_epi16(High, Weights));
+        }
+        alignas(32) uint32_t Lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(Lanes), Accumulator);
+        for (const uint32_t Lane: Lanes) {
+            Sum += Lane;
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        const __m128i Weights = _mm_set1_epi64x(0x0000001D0096004D);
+        __m128i Accumulator = _mm_setzero_si128();
+        for (; Index + 4 <= Count; Index += 4) {
+            const __m128i Values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + Index * 4));
+            const __m128i Low = _mm_unpacklo_epi8(Values, _mm_setzero_si128());
+            const __m128i High = _mm_unpackhi_epi8(Values, _mm_setzero_si128());
+            Accumulator = _mm_add_epi32(Accumulator, _mm_madd_epi16(Low, Weights));
+            Accumulator = _mm_add_epi32(Accumulator, _mm_madd_epi16(High, Weights));
+        }
+        alignas(16) uint32_t Lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(Lanes), Accumulator);
+        Sum = uint64_t(Lanes[0]) + Lanes[1] + Lanes[2] + Lanes[3];
+#elif defined(__ARM_NEON)
+        uint32x4_t Accumulator = vdupq_n_u32(0);
+        for (; Index + 16 <= Count; Index += 16) {
+            const uint8x16x4_t Values = vld4q_u8(Data + Index * 4);
+            uint16x8_t Low = vmull_u8(vget_low_u8(Values.val[0]), vdup_n_u8(77));
+            Low = vmlal_u8(Low, vget_low_u8(Values.val[1]), vdup_n_u8(150));
+            Low = vmlal_u8(Low, vget_low_u8(Values.val[2]), vdup_n_u8(29));
+            uint16x8_t High = vmull_u8(vget_high_u8(Values.val[0]), vdup_n_u8(77));
+            High = vmlal_u8(High, vget_high_u8(Values.val[1]), vdup_n_u8(150));
+            High = vmlal_u8(High, vget_high_u8(Values.val[2]), vdup_n_u8(29));
+            Accumulator = vpadalq_u16(vpadalq_u16(Accumulator, Low), High);
+        }
+        Sum = uint64_t(vgetq_lane_u32(Accumulator, 0)) + vgetq_lane_u32(Accumulator, 1) +
+              vgetq_lane_u32(Accumulator, 2) + vgetq_lane_u32(Accumulator, 3);
+#endif
+        for (; Index < Count; Index++) {
+            const uint8_t* const Pixel = Data + Index * 4;
+            Sum += 77 * Pixel[0] + 150 * Pixel[1] + 29 * Pixel[2];
+        }
+        return Sum;
+    }
+
+private:
+    static constexpr uint8_t BayerMatrix[8][8] = {
+        {0, 32, 8, 40, 2, 34, 10, 42},     {48, 16, 56, 24, 50, 18, 58, 26}, {12, 44, 4, 36, 14, 46, 6, 38},
+        {60, 28, 52, 20, 62, 30, 54, 22},  {3, 35, 11, 43, 1, 33, 9, 41},    {51, 19, 59, 27, 49, 17, 57, 25},
+        {15, 47, 7, 39, 13, 45, 5, 37},    {63, 31, 55, 23, 61, 29, 53, 21},
+    };
+
+    const ImageConversionSettings Settings;
+    /// Gamma and brightness curve
+    std::array<uint8_t, 256> Curve;
+};
+
+}    // namespace framework
+
+#if defined(INPUTMODULE_PLATFORM_LINUX)
+
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+namespace framework
+{
+
+/// @brief File of raw frames, back to back without any header, mapped in memory
+///
+/// Frames are read straight from the page cache, the kernel being told to read ahead as they are streamed
+class RawFrameFile
+{
+public:
+    RawFrameFile(const std::string& Path, int Width, int Height, PixelFormat Format)
+        : FrameWidth(Width),
+          FrameHeight(Height),
+          Format(Format),
+          FrameSize(Width > 0 && Height > 0 ? std::size_t(Width) * Height * (Format == PixelFormat::RGBA8 ? 4 : 1) : 0)
+    {
+        // Left invalid, frames without any pixel cannot be counted
+        if (FrameSize == 0) {
+            return;
+        }
+
+        FileFD = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (FileFD < 0) {
+            perror("open");
+            return;
+        }
+
+        struct stat FileStat;
+        if (fstat(FileFD, &FileStat)) {
+            perror("fstat");
+            return;
+        }
+        MappingSize = FileStat.st_size;
+        if (MappingSize < FrameSize) {
+            return;
+        }
+
+        void* const Mapping = mmap(nullptr, MappingSize, PROT_READ, MAP_PRIVATE, FileFD, 0);
+        if (Mapping == MAP_FAILED) {
+            perror("mmap");
+            return;
+        }
+        Data = static_cast<const uint8_t*>(Mapping);
+        if (madvise(Mapping, MappingSize, MADV_SEQUENTIAL)) {
+            perror("madvise");
+        }
+    }
+
+    ~RawFrameFile()
+    {
+        if (Data != nullptr) {
+            munmap(const_cast<uint8_t*>(Data), MappingSize);
+        }
+        if (FileFD >= 0) {
+            close(FileFD);
+        }
+    }
+
+    RawFrameFile(const RawFrameFile&) = delete;
+    RawFrameFile& operator=(const RawFrameFile&) = delete;
+
+    bool IsValid() const
+    {
+        return Data != nullptr;
+    }
+
+    /// Number of complete frames in the file
+    std::size_t GetFrameCount() const
+    {
+        return IsValid() ? MappingSize / FrameSize : 0;
+    }
+
+    /// Get a frame of the file, valid as long as the file is
+    ImageView GetFrame(std::size_t Index) const
+    {
+        INPUTMODULE_ASSERT(Index < GetFrameCount());
+        return ImageView{
+            .Data = Data + Index * FrameSize,
+            .Width = FrameWidth,
+            .Height = FrameHeight,
+            .Stride = FrameSize / FrameHeight,
+            .Format = Format,
+        };
+    }
+
+private:
+    const int FrameWidth;
+    const int FrameHeight;
+    const PixelFormat Format;
+    const std::size_t FrameSize;
+
+    int FileFD = -1;
+    const uint8_t* Data = nullptr;
+    std::size_t MappingSize = 0;
+};
+
+}    // namespace framework
+
+#endif    // INPUTMODULE_PLATFORM_LINUX
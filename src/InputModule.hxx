@@ -1,10 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <fcntl.h>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -19,6 +30,11 @@
     #define INPUTMODULE_ASSERT(x) assert(x)
 #endif    // INPUTMODULE_ASSERT
 
+/// Collect statistics on the commands sent to the input modules, set to 0 to compile them out
+#ifndef INPUTMODULE_STATS
+    #define INPUTMODULE_STATS 1
+#endif    // INPUTMODULE_STATS
+
 namespace framework
 {
 
@@ -285,14 +301,28 @@ namespace Commands
 
     /// @brief Payload for the SetPxColor command
     ///
-    /// Set a column of pixel
+    /// Set a column of pixel in the framebuffer, displayed on the next FlushFB
     struct [[gnu::packed]] SetPxColor {
         const PayloadHeader Header = {
             .Type = CommandType::SetPxColor,
         };
-        uint8_t Col = 0;
-        uint8_t ColorData[49] = {0};
+        // Little endian, the display is 300 pixels wide. Kept as bytes so that the payload has no padding
+        uint8_t Col[2] = {0};
+        // 400 pixels high column packed 1 bit per pixel, from the top, least significant bit first
+        uint8_t ColorData[50] = {0};
+
+        void SetColumn(uint16_t Column)
+        {
+            Col[0] = Column & 0xFF;
+            Col[1] = Column >> 8;
+        }
+
+        uint16_t GetColumn() const
+        {
+            return Col[0] | (Col[1] << 8);
+        }
     };
+    static_assert(sizeof(SetPxColor) == 2 + 50 + sizeof(PayloadHeader));
 
     /// @brief Payload for the FlushFB command
     ///
@@ -367,327 +397,1664 @@ concept TInputModulePayloadType = requires {
 template <typename T>
 concept TInputModulePayloadTypeWithReply = TInputModulePayloadType<T> && requires { typename T::Reply; };
 
-/// Main class representing a framework input module
-class IInputModule
+/// View a payload as the bytes sent to the device
+template <typename T>
+requires TInputModulePayloadType<T>
+std::span<const uint8_t> AsPayloadBytes(const T& Data)
 {
-private:
-public:
-    explicit IInputModule(InputModuleType Type): Type(Type)
-    {
-    }
+    return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(&Data), sizeof(T));
+}
+
+/// Build the bytes of a command, header included
+template <typename... ArgsType>
+requires(std::is_convertible_v<ArgsType, uint8_t> && ...)
+constexpr std::array<uint8_t, sizeof(Commands::PayloadHeader) + sizeof...(ArgsType)> MakePayload(CommandType Type,
+                                                                                                  ArgsType... Args)
+{
+    const Commands::PayloadHeader Header{
+        .Type = Type,
+    };
+    return {Header.Magic1, Header.Magic2, static_cast<uint8_t>(Header.Type), static_cast<uint8_t>(Args)...};
+}
+
+/// @brief Counters of the commands of one type sent to an input module
+struct InputModuleCommandStats {
+    uint64_t Commands = 0;       /// Commands written successfully
+    uint64_t Bytes = 0;          /// Bytes written, padding included
+    uint64_t Syscalls = 0;       /// System calls made to write the commands and read their replies
+    uint64_t ShortWrites = 0;    /// Writes that wrote less than asked
+    uint64_t Errors = 0;         /// Commands that failed, or whose reply was incomplete
+};
 
-    virtual ~IInputModule() = default;
+/// @brief Histogram of latencies, with power of two buckets
+struct InputModuleLatencyHistogram {
+    /// Bucket N counts the latencies in [2^(N-1), 2^N) microseconds, bucket 0 the ones under a microsecond. The last
+    /// bucket counts everything above 4 seconds
+    static constexpr std::size_t BucketCount = 24;
 
-    /// Is the device valid
-    virtual bool IsValid() const = 0;
+    std::array<uint64_t, BucketCount> Buckets = {};
 
-    template <typename T>
-    requires TInputModulePayloadTypeWithReply<T>
-    typename T::Reply WriteToDevice(const T& Data = {})
+    static std::size_t GetBucket(uint64_t Microseconds)
     {
-        const int WrittenData = WriteToDevice_Internal(reinterpret_cast<const uint8_t*>(&Data), sizeof(T));
-        if (WrittenData < 0) {
-            return typename T::Reply{};
-        }
-
-        // The firmware always return 32 bytes (ledmatrix/src/main.rs:481 response
-        // will always be a 32 bytes slice)
-        std::vector<std::uint8_t> Reply = ReadFromDevice_Internal(32);
-        if (Reply.empty()) {
-            return typename T::Reply{};
-        }
-
-        typename T::Reply ReplyData;
-        std::memcpy(&ReplyData, Reply.data(), sizeof(typename T::Reply));
-        return ReplyData;
+        return std::min<std::size_t>(std::bit_width(Microseconds), BucketCount - 1);
     }
 
-    template <typename T>
-    requires TInputModulePayloadType<T>
-    int WriteToDevice(const T& Data = {})
+    uint64_t GetCount() const
     {
-        return WriteToDevice_Internal(reinterpret_cast<const uint8_t*>(&Data), sizeof(T));
+        uint64_t Count = 0;
+        for (const uint64_t Bucket: Buckets) {
+            Count += Bucket;
+        }
+        return Count;
     }
 
-    template <typename... ArgsType>
-    requires(std::is_convertible_v<ArgsType, uint8_t> && ...)
-    /// Send a command to the device
+    /// Upper bound of a percentile, in microseconds
     ///
-    /// @return >= 0 on success, -1 on error
-    /// The return value contain the number of bytes written to the device
-    int WriteToDevice(CommandType Type, ArgsType... Args)
+    /// @param Ratio The percentile, between 0 and 1
+    /// @return 0 if there is no latency recorded
+    uint64_t GetPercentile(double Ratio) const
     {
-        std::vector<uint8_t> PayloadData(sizeof...(Args));
-
-        std::size_t Offset = 0;
-        ((PayloadData[Offset++] = uint8_t(Args)), ...);
+        const uint64_t Count = GetCount();
+        if (Count == 0) {
+            return 0;
+        }
 
-        return WriteToDevice(Type, PayloadData);
+        const uint64_t Rank = std::min<uint64_t>(Count - 1, static_cast<uint64_t>(Count * Ratio));
+        uint64_t Seen = 0;
+        for (std::size_t Bucket = 0; Bucket < BucketCount; Bucket++) {
+            Seen += Buckets[Bucket];
+            if (Seen > Rank) {
+                return uint64_t(1) << Bucket;
+            }
+        }
+        return uint64_t(1) << (BucketCount - 1);
     }
+};
 
-    /// Send a command to the device
-    int WriteToDevice(CommandType Type, const std::vector<uint8_t>& Data)
-    {
-        INPUTMODULE_ASSERT(IsValid());
-        const Commands::PayloadHeader Payload{
-            .Type = Type,
-        };
-        // Build the buffer to send to the device
-        // The buffer is initialized to the be correct size
-        std::vector<uint8_t> PayloadData(sizeof(Payload) + Data.size());
-        std::memcpy(PayloadData.data(), &Payload, sizeof(Payload));
-        /// And data are copied into it
-        std::memcpy(PayloadData.data() + sizeof(Payload), Data.data(), Data.size());
+/// @brief Snapshot of the statistics of an input module
+struct InputModuleStats {
+    static constexpr std::size_t CommandTypeCount = 256;
+
+    InputModuleType Type = InputModuleType::LEDMatrix;
+    /// Index of the input module among the ones of the same type, -1 when not taken from a manager
+    int Index = -1;
+
+    /// Counters of each command type, indexed by the command byte
+    std::array<InputModuleCommandStats, CommandTypeCount> Commands = {};
+    /// Time taken by the writes to the device
+    InputModuleLatencyHistogram WriteLatency;
+    /// Time from writing a command to having read its reply
+    InputModuleLatencyHistogram ReplyLatency;
 
-        return WriteToDevice_Internal(PayloadData.data(), PayloadData.size());
+    /// Counters of every command type summed together
+    InputModuleCommandStats GetTotal() const
+    {
+        InputModuleCommandStats Total;
+        for (const InputModuleCommandStats& Command: Commands) {
+            Total.Commands += Command.Commands;
+            Total.Bytes += Command.Bytes;
+            Total.Syscalls += Command.Syscalls;
+            Total.ShortWrites += Command.ShortWrites;
+            Total.Errors += Command.Errors;
+        }
+        return Total;
     }
 
-protected:
-    virtual int WriteToDevice_Internal(const uint8_t* Data, const int Size) = 0;
-    virtual std::vector<uint8_t> ReadFromDevice_Internal(const int ExpectedSize) = 0;
+    /// Human readable export, one line per command type used and per latency histogram
+    std::string ToString() const
+    {
+        static constexpr const char* TypeNames[] = {"LED Matrix", "B1 Display", "C1 Minimal Module"};
+        std::string Result = TypeNames[static_cast<int>(Type)];
+        if (Index >= 0) {
+            Result += " ";
+            Result += std::to_string(Index);
+        }
+        Result += "\n";
 
-private:
-    const InputModuleType Type;
+        for (std::size_t Command = 0; Command < CommandTypeCount; Command++) {
+            const InputModuleCommandStats& Stats = Commands[Command];
+            if (Stats.Commands == 0 && Stats.Errors == 0 && Stats.Syscalls == 0) {
+                continue;
+            }
+            char Line[160];
+            std::snprintf(Line, sizeof(Line),
+                          "  command 0x%02zx: %llu commands, %llu bytes, %llu syscalls, %llu short writes, "
+                          "%llu errors\n",
+                          Command, static_cast<unsigned long long>(Stats.Commands),
+                          static_cast<unsigned long long>(Stats.Bytes), static_cast<unsigned long long>(Stats.Syscalls),
+                          static_cast<unsigned long long>(Stats.ShortWrites),
+                          static_cast<unsigned long long>(Stats.Errors));
+            Result += Line;
+        }
+
+        const auto AppendHistogram = [&Result](const char* Name, const InputModuleLatencyHistogram& Histogram) {
+            if (Histogram.GetCount() == 0) {
+                return;
+            }
+            char Line[160];
+            std::snprintf(Line, sizeof(Line),
+                          "  %s latency: %llu samples, p50 < %llu us, p99 < %llu us, max < %llu us\n",
+                          Name, static_cast<unsigned long long>(Histogram.GetCount()),
+                          static_cast<unsigned long long>(Histogram.GetPercentile(0.50)),
+                          static_cast<unsigned long long>(Histogram.GetPercentile(0.99)),
+                          static_cast<unsigned long long>(Histogram.GetPercentile(1.0)));
+            Result += Line;
+        };
+        AppendHistogram("write", WriteLatency);
+        AppendHistogram("reply", ReplyLatency);
+        return Result;
+    }
 };
 
-class IInputModuleManager
+/// @brief Live statistics of an input module, updated from the I/O path
+///
+/// Every counter is a relaxed atomic, so recording never blocks and a snapshot may be taken from any thread. When
+/// INPUTMODULE_STATS is 0 every method is empty, the clock is never read and snapshots are always empty
+class InputModuleStatsCollector
 {
 public:
-    /// Get an input module of the requested type
-    ///
-    /// @param Type The type of the input module
-    /// @param Index The index of the input module of the requested type, like if there are multiple LED Matrix
-    /// @return A pointer to the input module, or nullptr if the input module is not available. The pointer is owned
-    /// by the Manager and should not be deleted
-    virtual IInputModule* GetInputModule(InputModuleType Type, int Index = 0) = 0;
-
-    /// Check if an input module of the requested type is available
-    ///
-    /// @param Type The type of the input module
-    /// @return The number of input module is available 0 if none, -1 if there were an error type is not supported
-    virtual int IsTypeOfInputModuleAvailable(InputModuleType Type) const = 0;
-};
-}    // namespace framework
+#if INPUTMODULE_STATS
+    using TimePoint = std::chrono::steady_clock::time_point;
 
-////////////////////////////////////////
-// Platform Implementation
-////////////////////////////////////////
-#if defined(INPUTMODULE_PLATFORM_LINUX)
+    static TimePoint Now()
+    {
+        return std::chrono::steady_clock::now();
+    }
 
-    #include <libudev.h>
-    #include <sys/ioctl.h>
-    #include <termios.h>
+    /// A command has been written
+    void RecordCommand(CommandType Type, std::size_t Bytes)
+    {
+        Counters& Command = PerCommand[static_cast<uint8_t>(Type)];
+        Command.Commands.fetch_add(1, std::memory_order_relaxed);
+        Command.Bytes.fetch_add(Bytes, std::memory_order_relaxed);
+    }
 
-namespace framework
-{
+    /// A command failed, or its reply was incomplete
+    void RecordError(CommandType Type)
+    {
+        PerCommand[static_cast<uint8_t>(Type)].Errors.fetch_add(1, std::memory_order_relaxed);
+    }
 
-class InputModuleLinux final : public IInputModule
-{
-public:
-    InputModuleLinux(InputModuleType Type, const std::string& FileDevicePath)
-        : IInputModule(Type), DeviceFD(open(FileDevicePath.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK))
+    /// A system call writing a command has been made
+    void RecordWriteSyscall(CommandType Type, bool bShortWrite)
     {
-        if (DeviceFD < 0) {
-            perror("open");
-            return;
+        Counters& Command = PerCommand[static_cast<uint8_t>(Type)];
+        Command.Syscalls.fetch_add(1, std::memory_order_relaxed);
+        if (bShortWrite) {
+            Command.ShortWrites.fetch_add(1, std::memory_order_relaxed);
         }
+    }
 
-        // Exclusive access to the device
-        if (ioctl(DeviceFD, TIOCEXCL)) {
-            perror("ioctl(TIOCEXCL)");
-            return;
-        }
+    /// The next replies read belong to this command
+    void SetPendingReply(CommandType Type)
+    {
+        PendingReply.store(static_cast<uint8_t>(Type), std::memory_order_relaxed);
+    }
 
-        // Remove the Non-Blocking flag
-        if (fcntl(DeviceFD, F_SETFL, 0)) {
-            perror("fcntl");
-            return;
-        }
+    /// A system call reading a reply has been made
+    void RecordReadSyscall()
+    {
+        PerCommand[PendingReply.load(std::memory_order_relaxed)].Syscalls.fetch_add(1, std::memory_order_relaxed);
+    }
 
-        struct termios TTYSettings;
-        if (tcgetattr(DeviceFD, &TTYSettings)) {
-            perror("tcgetattr");
-            return;
-        }
+    void RecordWriteLatency(TimePoint Start)
+    {
+        RecordLatency(WriteBuckets, Start);
+    }
 
-        // Set the terminal settings to be binary
-        TTYSettings.c_cflag |= CREAD | CLOCAL;
-        cfmakeraw(&TTYSettings);
+    void RecordReplyLatency(TimePoint Start)
+    {
+        RecordLatency(ReplyBuckets, Start);
+    }
 
-        if (tcsetattr(DeviceFD, TCSANOW, &TTYSettings)) {
-            perror("tcsetattr");
-            return;
+    InputModuleStats Snapshot() const
+    {
+        InputModuleStats Stats;
+        for (std::size_t Index = 0; Index < InputModuleStats::CommandTypeCount; Index++) {
+            const Counters& Command = PerCommand[Index];
+            Stats.Commands[Index] = InputModuleCommandStats{
+                .Commands = Command.Commands.load(std::memory_order_relaxed),
+                .Bytes = Command.Bytes.load(std::memory_order_relaxed),
+                .Syscalls = Command.Syscalls.load(std::memory_order_relaxed),
+                .ShortWrites = Command.ShortWrites.load(std::memory_order_relaxed),
+                .Errors = Command.Errors.load(std::memory_order_relaxed),
+            };
         }
-        if (tcflush(DeviceFD, TCIOFLUSH)) {
-            perror("tcflush");
-            return;
+        for (std::size_t Bucket = 0; Bucket < InputModuleLatencyHistogram::BucketCount; Bucket++) {
+            Stats.WriteLatency.Buckets[Bucket] = WriteBuckets[Bucket].load(std::memory_order_relaxed);
+            Stats.ReplyLatency.Buckets[Bucket] = ReplyBuckets[Bucket].load(std::memory_order_relaxed);
         }
+        return Stats;
+    }
 
-        // Parity settings : None
-        TTYSettings.c_cflag &= !(PARENB | PARODD);
-        TTYSettings.c_iflag &= !INPCK;
-        TTYSettings.c_iflag |= IGNPAR;
+private:
+    using Buckets = std::array<std::atomic<uint64_t>, InputModuleLatencyHistogram::BucketCount>;
+
+    struct Counters {
+        std::atomic<uint64_t> Commands = 0;
+        std::atomic<uint64_t> Bytes = 0;
+        std::atomic<uint64_t> Syscalls = 0;
+        std::atomic<uint64_t> ShortWrites = 0;
+        std::atomic<uint64_t> Errors = 0;
+    };
 
-        // Flow control settings : None
-        TTYSettings.c_iflag &= !(IXON | IXOFF);
-        TTYSettings.c_cflag &= !CRTSCTS;
+    static void RecordLatency(Buckets& Histogram, TimePoint Start)
+    {
+        const uint64_t Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Now() - Start).count();
+        Histogram[InputModuleLatencyHistogram::GetBucket(Elapsed)].fetch_add(1, std::memory_order_relaxed);
+    }
 
-        // Set data bit: 8
-        TTYSettings.c_cflag &= !CSIZE;
-        TTYSettings.c_cflag |= CS8;
+private:
+    std::array<Counters, InputModuleStats::CommandTypeCount> PerCommand;
+    Buckets WriteBuckets = {};
+    Buckets ReplyBuckets = {};
+    std::atomic<uint8_t> PendingReply = 0;
+#else
+    struct TimePoint {
+    };
 
-        // Set stop bit: 1
-        TTYSettings.c_cflag &= !CSTOPB;
-        cfsetspeed(&TTYSettings, B115200);
-        tcsetattr(DeviceFD, TCSANOW, &TTYSettings);
+    static TimePoint Now()
+    {
+        return {};
     }
-    virtual ~InputModuleLinux()
+    void RecordCommand(CommandType, std::size_t)
     {
-        if (DeviceFD > 0) {
-            if (ioctl(DeviceFD, TIOCNXCL)) {
-                perror("ioctl(TIOCNXCL)");
-            }
-            close(DeviceFD);
-        }
     }
-
-    virtual bool IsValid() const override
+    void RecordError(CommandType)
     {
-        return DeviceFD > 0;
     }
-
-protected:
-    virtual int WriteToDevice_Internal(const uint8_t* Data, const int Size) override
+    void RecordWriteSyscall(CommandType, bool)
     {
-        return write(DeviceFD, Data, Size);
     }
-
-    virtual std::vector<uint8_t> ReadFromDevice_Internal(const int ExpectedSize) override
+    void SetPendingReply(CommandType)
     {
-        std::vector<uint8_t> Buffer(ExpectedSize);
-        read(DeviceFD, Buffer.data(), ExpectedSize);
-        return Buffer;
     }
-
-private:
-    const int DeviceFD = 0;
-};
-
-class InputModuleManagerLinux final : public IInputModuleManager
-{
-public:
-    InputModuleManagerLinux()
+    void RecordReadSyscall()
     {
-        // #TODO smart pointer with custom deleter
-        struct udev* UdevContext = udev_new();
-        INPUTMODULE_ASSERT(UdevContext != nullptr);
+    }
+    void RecordWriteLatency(TimePoint)
+    {
+    }
+    void RecordReplyLatency(TimePoint)
+    {
+    }
+    InputModuleStats Snapshot() const
+    {
+        return {};
+    }
+#endif    // INPUTMODULE_STATS
+};
 
-        // We list every tty udev device
-        struct udev_enumerate* enumerate = udev_enumerate_new(UdevContext);
-        udev_enumerate_add_match_subsystem(enumerate, "tty");
-        udev_enumerate_scan_devices(enumerate);
+class InputModuleAsyncQueue;
 
-        /// Iterate over the list of devices
-        struct udev_list_entry* list = nullptr;
-        struct udev_list_entry* node = nullptr;
-        list = udev_enumerate_get_list_entry(enumerate);
-        udev_list_entry_foreach(node, list)
-        {
-            const std::string_view SysPath = udev_list_entry_get_name(node);
-            struct udev_device* const dev = udev_device_new_from_syspath(UdevContext, SysPath.data());
+/// Main class representing a framework input module
+class IInputModule
+{
+    friend class InputModuleAsyncQueue;
+    friend class InputModuleReactorDevice;
 
-            const char* const SerialShortPtr = udev_device_get_property_value(dev, "ID_SERIAL_SHORT");
-            if (SerialShortPtr == nullptr) {
-                udev_device_unref(dev);
-                continue;
-            }
-            const std::string_view SerialShort(SerialShortPtr);
-            if (!SerialShort.starts_with("FRA")) {
-                udev_device_unref(dev);
-                continue;    // Not a Framework device
-            }
-
-            // #HACK
-            // I don't have another device to test with and the firmware seem to have the wrong serial number
-            // for the B1 display
-            // Framework device serial number format
-            //                            FRA                - Framwork
-            //                               KDE             - C1 LED Matrix
-            //                                  BZ           - BizLink
-            //                                    01         - SKU, Default Configuration
-            //                                      00000000 - Device Identifier
-            if (!SerialShort.starts_with("FRAKDEBZ")) {
-                udev_device_unref(dev);
-                continue;    // Not a Framework device
-            }
-
-            const char* const DevName = udev_device_get_property_value(dev, "DEVNAME");
-            const std::size_t DevNameSize = std::strlen(DevName);
-            if (DevName == nullptr) {
-                udev_device_unref(dev);
-                continue;
-            }
-            if (DevNameSize == 0) {
-                udev_device_unref(dev);
-                continue;
-            }
+public:
+    /// The firmware always return 32 bytes (ledmatrix/src/main.rs:481 response will always be a 32 bytes slice)
+    static constexpr std::size_t ReplySize = 32;
+    /// The firmware reads the serial port 64 bytes at a time, and parses a single command out of each read
+    static constexpr std::size_t PacketSize = 64;
 
-            std::unique_ptr<InputModuleLinux> InputModule =
-                std::make_unique<InputModuleLinux>(InputModuleType::LEDMatrix, std::string(DevName, DevNameSize));
-            InputModulesMap[InputModuleType::LEDMatrix].emplace_back(std::move(InputModule));
-            udev_device_unref(dev);
-        }
-        udev_enumerate_unref(enumerate);
-        udev_unref(UdevContext);
+public:
+    explicit IInputModule(InputModuleType Type): Type(Type)
+    {
     }
 
-    virtual IInputModule* GetInputModule(InputModuleType Type, int Index = 0) override
-    {
-        const auto Iter = InputModulesMap.find(Type);
-        if (Iter == InputModulesMap.end()) {
-            return nullptr;
-        }
+    virtual ~IInputModule() = default;
 
-        if (Index >= Iter->second.size()) {
-            return nullptr;
-        }
-        return Iter->second[Index].get();
-    }
+    /// Is the device valid
+    virtual bool IsValid() const = 0;
 
-    virtual int IsTypeOfInputModuleAvailable(InputModuleType Type) const override
+    InputModuleType GetType() const
     {
-        const auto Iter = InputModulesMap.find(Type);
-        if (Iter == InputModulesMap.end()) {
-            return 0;
-        }
-        return Iter->second.size();
+        return Type;
     }
 
-private:
-    using InputModuleList = std::vector<std::unique_ptr<IInputModule>>;
-    std::unordered_map<InputModuleType, InputModuleList> InputModulesMap;
-};
+    /// Get the asynchronous command queue of the device
+    ///
+    /// The queue is created on first use, with a writer thread dedicated to the device. Commands submitted to the
+    /// queue must not be interleaved with direct calls to WriteToDevice
+    /// @return A pointer to the queue, or nullptr if the platform does not support it. The pointer is owned by the
+    /// input module
+    virtual InputModuleAsyncQueue* GetAsyncQueue() = 0;
 
-using InputModuleManager = InputModuleManagerLinux;
+    /// Block until everything written to the device has been transmitted
+    ///
+    /// @return false on error
+    virtual bool WaitForTransmission() = 0;
 
-}    // namespace framework
+    /// Set the longest time a command may take to be written, or its reply to be read
+    virtual void SetTimeout(std::chrono::milliseconds Timeout) = 0;
 
-#elif defined(INPUTMODULE_PLATFORM_WINDOWS)
+    /// Longest time a command may take to be written, or its reply to be read
+    virtual std::chrono::milliseconds GetTimeout() const = 0;
 
-namespace framework
-{
+    /// Duplicate the descriptor of the device, for an event loop like InputModuleReactor to do its I/O on it
+    ///
+    /// @return The new descriptor, owned by the caller, -1 if the device is not open or the platform does not support
+    /// it
+    virtual int DuplicateDescriptor() = 0;
 
-class InputModuleManagerWindows final : public IInputModuleManager
-{
-public:
-    InputModuleManagerWindows()
+    /// Snapshot the statistics of the device, empty when INPUTMODULE_STATS is 0
+    InputModuleStats GetStats() const
     {
+        InputModuleStats Snapshot = Stats.Snapshot();
+        Snapshot.Type = Type;
+        return Snapshot;
     }
 
-    virtual IInputModule* GetInputModule(InputModuleType Type, int Index = 0) override
+    template <typename T>
+    requires TInputModulePayloadTypeWithReply<T>
+    typename T::Reply WriteToDevice(const T& Data = {})
     {
-        assert(false && "Not implemented");
-        return nullptr;
+        std::array<uint8_t, ReplySize> Reply;
+        if (WriteToDevice(Data, Reply) < static_cast<int>(sizeof(typename T::Reply))) {
+            return typename T::Reply{};
+        }
+
+        typename T::Reply ReplyData;
+        std::memcpy(&ReplyData, Reply.data(), sizeof(typename T::Reply));
+        return ReplyData;
+    }
+
+    /// Send a command to the device and read its raw reply into the given buffer
+    ///
+    /// @return The number of bytes of reply read, -1 on error
+    template <typename T>
+    requires TInputModulePayloadTypeWithReply<T>
+    int WriteToDevice(const T& Data, std::span<uint8_t> ReplyBuffer)
+    {
+        INPUTMODULE_ASSERT(ReplyBuffer.size() >= ReplySize);
+        const InputModuleStatsCollector::TimePoint Start = InputModuleStatsCollector::Now();
+        DiscardInput_Internal();
+        const int WrittenData = WriteCommand(AsPayloadBytes(Data));
+        if (WrittenData < 0) {
+            return -1;
+        }
+        return ReadReply(Data.Header.Type, ReplyBuffer.first(ReplySize), Start);
+    }
+
+    template <typename T>
+    requires TInputModulePayloadType<T>
+    int WriteToDevice(const T& Data = {})
+    {
+        return WriteCommand(AsPayloadBytes(Data));
+    }
+
+    template <typename... ArgsType>
+    requires(std::is_convertible_v<ArgsType, uint8_t> && ...)
+    /// Send a command to the device
+    ///
+    /// @return >= 0 on success, -1 on error
+    /// The return value contain the number of bytes written to the device
+    int WriteToDevice(CommandType Type, ArgsType... Args)
+    {
+        // The device may be unplugged at any time
+        if (!IsValid()) {
+            return -1;
+        }
+        const auto PayloadData = MakePayload(Type, Args...);
+        return WriteCommand(PayloadData);
+    }
+
+    /// Send a command to the device
+    int WriteToDevice(CommandType Type, std::span<const uint8_t> Data)
+    {
+        if (!IsValid()) {
+            return -1;
+        }
+        const auto Header = MakePayload(Type);
+        const std::array<std::span<const uint8_t>, 2> Buffers = {Header, Data};
+
+        const InputModuleStatsCollector::TimePoint Start = InputModuleStatsCollector::Now();
+        const int WrittenData = WriteBatchToDevice_Internal(Buffers);
+        Stats.RecordWriteLatency(Start);
+        if (WrittenData < 0) {
+            Stats.RecordError(Type);
+            return -1;
+        }
+        Stats.RecordCommand(Type, WrittenData);
+        return WrittenData;
+    }
+
+    /// Send several commands to the device with a single system call
+    ///
+    /// Every command but the last is padded with zeros to a full packet, so that the firmware reads them one by one
+    /// @return The total number of bytes written to the device, padding included, -1 on error
+    template <typename... T>
+    requires((TInputModulePayloadType<T> && !TInputModulePayloadTypeWithReply<T>) && ...)
+    int WriteBatchToDevice(const T&... Payloads)
+    {
+        static_assert(((sizeof(T) <= PacketSize) && ...));
+        const std::array<std::span<const uint8_t>, sizeof...(T)> Buffers = {AsPayloadBytes(Payloads)...};
+        return WriteBatchToDevice(Buffers);
+    }
+
+    /// Send several raw commands to the device with a single system call
+    ///
+    /// Every command but the last is padded with zeros to a full packet, so that the firmware reads them one by one
+    /// @return The total number of bytes written to the device, padding included, -1 on error
+    int WriteBatchToDevice(std::span<const std::span<const uint8_t>> Payloads)
+    {
+        if (!IsValid()) {
+            return -1;
+        }
+        static constexpr std::array<uint8_t, PacketSize> Padding = {};
+
+        // Each command takes two buffers, itself and its padding
+        constexpr std::size_t MaxPayloads = 32;
+        std::array<std::span<const uint8_t>, MaxPayloads * 2> Buffers;
+
+        int WrittenData = 0;
+        for (std::size_t Offset = 0; Offset < Payloads.size(); Offset += MaxPayloads) {
+            const std::size_t Count = std::min(MaxPayloads, Payloads.size() - Offset);
+
+            std::size_t BufferCount = 0;
+            for (std::size_t Index = Offset; Index < Offset + Count; Index++) {
+                const std::span<const uint8_t> Payload = Payloads[Index];
+                INPUTMODULE_ASSERT(Payload.size() <= PacketSize);
+
+                Buffers[BufferCount++] = Payload;
+                if (Index + 1 < Payloads.size() && Payload.size() < PacketSize) {
+                    Buffers[BufferCount++] = std::span(Padding).first(PacketSize - Payload.size());
+                }
+            }
+
+            const InputModuleStatsCollector::TimePoint Start = InputModuleStatsCollector::Now();
+            const int Result = WriteBatchToDevice_Internal(std::span(Buffers.data(), BufferCount));
+            Stats.RecordWriteLatency(Start);
+            if (Result < 0) {
+                Stats.RecordError(GetCommandType(Payloads[Offset]));
+                return -1;
+            }
+            for (std::size_t Index = Offset; Index < Offset + Count; Index++) {
+                const std::size_t Size = Payloads[Index].size();
+                Stats.RecordCommand(GetCommandType(Payloads[Index]),
+                                    Index + 1 < Payloads.size() ? std::max(Size, PacketSize) : Size);
+            }
+            WrittenData += Result;
+        }
+        return WrittenData;
+    }
+
+protected:
+    /// Type of a command, from its bytes
+    static CommandType GetCommandType(std::span<const uint8_t> Payload)
+    {
+        INPUTMODULE_ASSERT(Payload.size() >= sizeof(Commands::PayloadHeader));
+        return static_cast<CommandType>(Payload[2]);
+    }
+
+    virtual int WriteToDevice_Internal(std::span<const uint8_t> Data) = 0;
+    /// Write the buffers one after the other, as if they were a single one
+    virtual int WriteBatchToDevice_Internal(std::span<const std::span<const uint8_t>> Buffers) = 0;
+    /// @return The number of bytes read, -1 on error
+    virtual int ReadFromDevice_Internal(std::span<uint8_t> Buffer) = 0;
+    /// Drop what the device sent that was not read, like the late reply of a command that timed out
+    ///
+    /// Called before writing a command with a reply, so that its reply is not mistaken for an older one
+    virtual void DiscardInput_Internal() = 0;
+
+private:
+    /// Write a single command, and record it
+    int WriteCommand(std::span<const uint8_t> Payload)
+    {
+        const InputModuleStatsCollector::TimePoint Start = InputModuleStatsCollector::Now();
+        const int WrittenData = WriteToDevice_Internal(Payload);
+        Stats.RecordWriteLatency(Start);
+        if (WrittenData < 0) {
+            Stats.RecordError(GetCommandType(Payload));
+        } else {
+            Stats.RecordCommand(GetCommandType(Payload), WrittenData);
+        }
+        return WrittenData;
+    }
+
+    /// Read the reply of a command, and record the time since the command started to be written
+    int ReadReply(CommandType Command, std::span<uint8_t> Buffer, InputModuleStatsCollector::TimePoint Start)
+    {
+        Stats.SetPendingReply(Command);
+        const int ReadData = ReadFromDevice_Internal(Buffer);
+        if (ReadData < static_cast<int>(Buffer.size())) {
+            Stats.RecordError(Command);
+        } else {
+            Stats.RecordReplyLatency(Start);
+        }
+        return ReadData;
+    }
+
+protected:
+    /// Updated by the backend for the system calls it makes
+    InputModuleStatsCollector Stats;
+
+private:
+    const InputModuleType Type;
+};
+
+/// @brief Asynchronous command queue of an input module
+///
+/// Commands are pushed to a bounded lock-free queue and written to the device by a dedicated thread, so the
+/// submitting threads never block on the device. Commands with a reply return a future that is fulfilled once the
+/// reply has been read.
+///
+/// When the writer thread falls behind, Brightness, Pattern and Animate commands that are superseded by a later
+/// command of the same type are dropped before reaching the device. Commands with a reply act as a barrier: nothing
+/// is merged across them, so they always observe every command submitted before them.
+class InputModuleAsyncQueue
+{
+public:
+    /// Biggest payload that can be submitted, header included
+    static constexpr std::size_t MaxPayloadSize = 64;
+
+public:
+    /// @param Module The input module to write to, it must outlive the queue
+    /// @param Capacity Maximum number of pending commands, rounded up to a power of two
+    explicit InputModuleAsyncQueue(IInputModule& Module, std::size_t Capacity = 256): Module(Module)
+    {
+        std::size_t RoundedCapacity = 1;
+        while (RoundedCapacity < Capacity) {
+            RoundedCapacity <<= 1;
+        }
+        Mask = RoundedCapacity - 1;
+        Slots = std::make_unique<Slot[]>(RoundedCapacity);
+        for (std::size_t Index = 0; Index < RoundedCapacity; Index++) {
+            Slots[Index].Sequence.store(Index, std::memory_order_relaxed);
+        }
+
+        WriterThread = std::jthread([this](std::stop_token StopToken) { Run(StopToken); });
+    }
+
+    /// Every pending command is written before the queue is destroyed
+    ~InputModuleAsyncQueue()
+    {
+        WriterThread.request_stop();
+        SubmitCounter.fetch_add(1, std::memory_order_release);
+        SubmitCounter.notify_one();
+    }
+
+    InputModuleAsyncQueue(const InputModuleAsyncQueue&) = delete;
+    InputModuleAsyncQueue& operator=(const InputModuleAsyncQueue&) = delete;
+
+    /// Queue a command with a reply
+    ///
+    /// @return A future holding the reply. If the queue is full or the device fails, the reply is default constructed
+    template <typename T>
+    requires TInputModulePayloadTypeWithReply<T>
+    std::future<typename T::Reply> Submit(const T& Data = {})
+    {
+        static_assert(sizeof(T) <= MaxPayloadSize);
+        using ReplyType = typename T::Reply;
+
+        std::shared_ptr<std::promise<ReplyType>> Promise = std::make_shared<std::promise<ReplyType>>();
+        std::future<ReplyType> Future = Promise->get_future();
+
+        Entry Command = MakeEntry(AsPayloadBytes(Data));
+        Command.OnReply = [Promise](const uint8_t* Reply, std::size_t Size) {
+            ReplyType ReplyData;
+            if (Size >= sizeof(ReplyType)) {
+                std::memcpy(&ReplyData, Reply, sizeof(ReplyType));
+            }
+            Promise->set_value(ReplyData);
+        };
+        if (!Enqueue(Command)) {
+            Command.OnReply(nullptr, 0);
+        }
+        return Future;
+    }
+
+    /// Queue a command
+    ///
+    /// @return false if the queue is full
+    template <typename T>
+    requires TInputModulePayloadType<T>
+    bool Submit(const T& Data = {})
+    {
+        static_assert(sizeof(T) <= MaxPayloadSize);
+        Entry Command = MakeEntry(AsPayloadBytes(Data));
+        return Enqueue(Command);
+    }
+
+    /// Queue a command
+    ///
+    /// @return false if the queue is full
+    template <typename... ArgsType>
+    requires(std::is_convertible_v<ArgsType, uint8_t> && ...)
+    bool Submit(CommandType Type, ArgsType... Args)
+    {
+        static_assert(sizeof(Commands::PayloadHeader) + sizeof...(Args) <= MaxPayloadSize);
+        Entry Command = MakeEntry(MakePayload(Type, Args...));
+        return Enqueue(Command);
+    }
+
+    /// Block until every command queued before the call has been handled
+    ///
+    /// Commands are handled in the order of their position in the queue, so every command queued before the call is
+    /// handled once the writer thread is past the last position taken
+    void Flush()
+    {
+        const std::size_t Target = EnqueuePosition.load(std::memory_order_acquire);
+        std::size_t Current = CompletedPosition.load(std::memory_order_acquire);
+        while (Current < Target) {
+            CompletedPosition.wait(Current, std::memory_order_acquire);
+            Current = CompletedPosition.load(std::memory_order_acquire);
+        }
+    }
+
+private:
+    struct Entry {
+        std::array<uint8_t, MaxPayloadSize> Data = {};
+        /// Size of the payload, 0 once superseded by a later command
+        uint8_t Size = 0;
+        /// Called with the reply of the device, or with a size of 0 if there is none
+        std::function<void(const uint8_t*, std::size_t)> OnReply;
+    };
+
+    struct Slot {
+        std::atomic<std::size_t> Sequence = 0;
+        Entry Value;
+    };
+
+    static Entry MakeEntry(std::span<const uint8_t> Payload)
+    {
+        Entry Command;
+        std::memcpy(Command.Data.data(), Payload.data(), Payload.size());
+        Command.Size = static_cast<uint8_t>(Payload.size());
+        return Command;
+    }
+
+    /// Bounded multi-producer queue (Dmitry Vyukov's algorithm)
+    ///
+    /// @return false if the queue is full, in which case Command is left untouched
+    bool Enqueue(Entry& Command)
+    {
+        std::size_t Position = EnqueuePosition.load(std::memory_order_relaxed);
+        Slot* Target = nullptr;
+        while (true) {
+            Target = &Slots[Position & Mask];
+            const std::size_t Sequence = Target->Sequence.load(std::memory_order_acquire);
+            const std::intptr_t Difference = std::intptr_t(Sequence) - std::intptr_t(Position);
+            if (Difference == 0) {
+                if (EnqueuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (Difference < 0) {
+                return false;
+            } else {
+                Position = EnqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        Target->Value = std::move(Command);
+        Target->Sequence.store(Position + 1, std::memory_order_release);
+
+        SubmitCounter.fetch_add(1, std::memory_order_release);
+        SubmitCounter.notify_one();
+        return true;
+    }
+
+    /// Only called from the writer thread
+    bool Dequeue(Entry& Command)
+    {
+        Slot& Source = Slots[DequeuePosition & Mask];
+        const std::size_t Sequence = Source.Sequence.load(std::memory_order_acquire);
+        if (std::intptr_t(Sequence) - std::intptr_t(DequeuePosition + 1) < 0) {
+            return false;
+        }
+        Command = std::move(Source.Value);
+        Source.Sequence.store(DequeuePosition + Mask + 1, std::memory_order_release);
+        DequeuePosition++;
+        return true;
+    }
+
+    /// Drop the Brightness, Pattern and Animate commands that are overwritten before being sent
+    static void Coalesce(std::vector<Entry>& Batch)
+    {
+        constexpr std::size_t None = ~std::size_t(0);
+        std::array<std::size_t, 3> LastIndex = {None, None, None};
+
+        for (std::size_t Index = 0; Index < Batch.size(); Index++) {
+            const Entry& Command = Batch[Index];
+            if (Command.OnReply) {
+                LastIndex.fill(None);
+                continue;
+            }
+            // Getters share their id with the setters, but have no argument
+            if (Command.Size <= sizeof(Commands::PayloadHeader)) {
+                continue;
+            }
+
+            std::size_t Kind = None;
+            switch (static_cast<CommandType>(Command.Data[2])) {
+                case CommandType::Brightness: Kind = 0; break;
+                case CommandType::Pattern: Kind = 1; break;
+                case CommandType::Animate: Kind = 2; break;
+                default: continue;
+            }
+            if (LastIndex[Kind] != None) {
+                Batch[LastIndex[Kind]].Size = 0;
+            }
+            LastIndex[Kind] = Index;
+        }
+    }
+
+    void Send(Entry& Command)
+    {
+        if (Command.Size == 0) {
+            return;
+        }
+
+        const std::span<const uint8_t> Payload(Command.Data.data(), Command.Size);
+        const InputModuleStatsCollector::TimePoint Start = InputModuleStatsCollector::Now();
+        if (Command.OnReply) {
+            Module.DiscardInput_Internal();
+        }
+        const int WrittenData = Module.WriteCommand(Payload);
+        if (!Command.OnReply) {
+            return;
+        }
+        if (WrittenData < 0) {
+            Command.OnReply(nullptr, 0);
+            return;
+        }
+        std::array<uint8_t, IInputModule::ReplySize> Reply;
+        const int ReadData = Module.ReadReply(IInputModule::GetCommandType(Payload), Reply, Start);
+        Command.OnReply(Reply.data(), ReadData < 0 ? 0 : ReadData);
+    }
+
+    void Run(std::stop_token StopToken)
+    {
+        std::vector<Entry> Batch;
+        Batch.reserve(Mask + 1);
+
+        while (true) {
+            const uint32_t Seen = SubmitCounter.load(std::memory_order_acquire);
+
+            Entry Command;
+            while (Batch.size() <= Mask && Dequeue(Command)) {
+                Batch.emplace_back(std::move(Command));
+            }
+            if (Batch.empty()) {
+                if (StopToken.stop_requested()) {
+                    return;
+                }
+                SubmitCounter.wait(Seen, std::memory_order_acquire);
+                continue;
+            }
+
+            Coalesce(Batch);
+            for (Entry& Pending: Batch) {
+                Send(Pending);
+            }
+
+            CompletedPosition.store(DequeuePosition, std::memory_order_release);
+            CompletedPosition.notify_all();
+            Batch.clear();
+        }
+    }
+
+private:
+    IInputModule& Module;
+
+    std::unique_ptr<Slot[]> Slots;
+    std::size_t Mask = 0;
+    std::atomic<std::size_t> EnqueuePosition = 0;
+    std::size_t DequeuePosition = 0;
+
+    /// Bumped on every submission to wake up the writer thread
+    std::atomic<uint32_t> SubmitCounter = 0;
+    /// Position up to which the commands have been handled
+    std::atomic<std::size_t> CompletedPosition = 0;
+
+    /// Declared last so it is joined before anything else is destroyed
+    std::jthread WriterThread;
+};
+
+/// @brief Settings of an input module manager
+struct InputModuleManagerSettings {
+    /// Keep watching for input modules being plugged or unplugged
+    bool bWatchHotplug = false;
+    /// Open the input modules when they are used for the first time, instead of when they are discovered
+    bool bOpenLazily = false;
+};
+
+class IInputModuleManager
+{
+public:
+    /// Called with the input module that was plugged or unplugged
+    using InputModuleCallback = std::function<void(IInputModule*)>;
+
+public:
+    virtual ~IInputModuleManager() = default;
+
+    /// Get an input module of the requested type
+    ///
+    /// @param Type The type of the input module
+    /// @param Index The index of the input module of the requested type, like if there are multiple LED Matrix
+    /// @return A pointer to the input module, or nullptr if the input module is not available. The pointer is owned
+    /// by the Manager and should not be deleted
+    virtual IInputModule* GetInputModule(InputModuleType Type, int Index = 0) = 0;
+
+    /// Check if an input module of the requested type is available
+    ///
+    /// @param Type The type of the input module
+    /// @return The number of input module is available 0 if none, -1 if there were an error type is not supported.
+    /// Input modules unplugged are counted too, they keep their index and are not valid until plugged back
+    virtual int IsTypeOfInputModuleAvailable(InputModuleType Type) const = 0;
+
+    /// Snapshot the statistics of every input module of the manager
+    virtual std::vector<InputModuleStats> GetStats()
+    {
+        std::vector<InputModuleStats> Snapshots;
+        for (const InputModuleType Type:
+             {InputModuleType::LEDMatrix, InputModuleType::B1Display, InputModuleType::C1MinimalModule}) {
+            const int Count = IsTypeOfInputModuleAvailable(Type);
+            for (int Index = 0; Index < Count; Index++) {
+                if (const IInputModule* const Module = GetInputModule(Type, Index)) {
+                    InputModuleStats& Snapshot = Snapshots.emplace_back(Module->GetStats());
+                    Snapshot.Index = Index;
+                }
+            }
+        }
+        return Snapshots;
+    }
+
+    /// Export the statistics of every input module of the manager as text
+    std::string ExportStats()
+    {
+        std::string Result;
+        for (const InputModuleStats& Snapshot: GetStats()) {
+            Result += Snapshot.ToString();
+        }
+        return Result;
+    }
+
+    /// Set the function called when an input module is plugged
+    ///
+    /// Only called when watching for hotplug, from the thread of the manager. An input module plugged back is given
+    /// with the same pointer as before it was unplugged
+    void SetOnInputModuleAdded(InputModuleCallback Callback)
+    {
+        std::scoped_lock Lock(CallbacksMutex);
+        OnInputModuleAdded = std::move(Callback);
+    }
+
+    /// Set the function called when an input module is unplugged
+    ///
+    /// Only called when watching for hotplug, from the thread of the manager. The input module stays owned by the
+    /// manager, but is not valid anymore
+    void SetOnInputModuleRemoved(InputModuleCallback Callback)
+    {
+        std::scoped_lock Lock(CallbacksMutex);
+        OnInputModuleRemoved = std::move(Callback);
+    }
+
+protected:
+    void NotifyInputModuleAdded(IInputModule* Module) const
+    {
+        InputModuleCallback Callback;
+        {
+            std::scoped_lock Lock(CallbacksMutex);
+            Callback = OnInputModuleAdded;
+        }
+        if (Callback) {
+            Callback(Module);
+        }
+    }
+
+    void NotifyInputModuleRemoved(IInputModule* Module) const
+    {
+        InputModuleCallback Callback;
+        {
+            std::scoped_lock Lock(CallbacksMutex);
+            Callback = OnInputModuleRemoved;
+        }
+        if (Callback) {
+            Callback(Module);
+        }
+    }
+
+private:
+    mutable std::mutex CallbacksMutex;
+    InputModuleCallback OnInputModuleAdded;
+    InputModuleCallback OnInputModuleRemoved;
+};
+}    // namespace framework
+
+////////////////////////////////////////
+// Platform Implementation
+////////////////////////////////////////
+#if defined(INPUTMODULE_PLATFORM_LINUX)
+
+    #include <cerrno>
+    #include <libudev.h>
+    #include <optional>
+    #include <poll.h>
+    #include <shared_mutex>
+    #include <sys/eventfd.h>
+    #include <sys/ioctl.h>
+    #include <sys/uio.h>
+    #include <termios.h>
+    #include <unistd.h>
+
+namespace framework
+{
+
+class InputModuleLinux : public IInputModule
+{
+public:
+    /// Longest time a command may take to be written, or its reply to be read, unless set otherwise
+    static constexpr std::chrono::milliseconds DefaultTimeout{1000};
+
+public:
+    /// @param Type The type of the input module
+    /// @param FileDevicePath Path of the terminal of the device
+    /// @param bOpenLazily Defer opening the device until it is used for the first time
+    InputModuleLinux(InputModuleType Type, const std::string& FileDevicePath, bool bOpenLazily = false)
+        : IInputModule(Type), DevicePath(FileDevicePath)
+    {
+        if (!bOpenLazily) {
+            Open();
+        }
+    }
+
+    /// Take ownership of an already opened terminal and configure it
+    InputModuleLinux(InputModuleType Type, int FileDescriptor): IInputModule(Type)
+    {
+        std::unique_lock Lock(DeviceMutex);
+        ConfigureDevice(FileDescriptor);
+    }
+
+    virtual ~InputModuleLinux()
+    {
+        CloseDevice();
+    }
+
+    /// Is the device valid
+    ///
+    /// A device opened lazily is valid until opening it fails. A device unplugged is not valid until plugged back
+    virtual bool IsValid() const override
+    {
+        return bConnected.load(std::memory_order_acquire) && !bOpenFailed.load(std::memory_order_acquire);
+    }
+
+    virtual InputModuleAsyncQueue* GetAsyncQueue() override
+    {
+        std::call_once(AsyncQueueFlag, [this] { AsyncQueue = std::make_unique<InputModuleAsyncQueue>(*this); });
+        return AsyncQueue.get();
+    }
+
+    virtual bool WaitForTransmission() override
+    {
+        const std::shared_lock Lock = AcquireDevice();
+        if (DeviceFD < 0) {
+            return false;
+        }
+        return tcdrain(DeviceFD) == 0;
+    }
+
+    /// Path of the terminal of the device, empty if it was created from a file descriptor
+    const std::string& GetDevicePath() const
+    {
+        return DevicePath;
+    }
+
+    virtual void SetTimeout(std::chrono::milliseconds Timeout) override
+    {
+        TimeoutMilliseconds.store(static_cast<int>(Timeout.count()), std::memory_order_relaxed);
+    }
+
+    virtual std::chrono::milliseconds GetTimeout() const override
+    {
+        return std::chrono::milliseconds(TimeoutMilliseconds.load(std::memory_order_relaxed));
+    }
+
+    /// The device is opened first if it was opened lazily. The duplicate shares the non-blocking mode of the device
+    virtual int DuplicateDescriptor() override
+    {
+        const std::shared_lock Lock = AcquireDevice();
+        if (DeviceFD < 0) {
+            return -1;
+        }
+        return fcntl(DeviceFD, F_DUPFD_CLOEXEC, 0);
+    }
+
+    /// Open the device if it is not already
+    ///
+    /// @return true if the device is open
+    bool Open()
+    {
+        std::unique_lock Lock(DeviceMutex);
+        return OpenDevice_Locked();
+    }
+
+    /// Close the device because it has been unplugged, every command fails until it is reconnected
+    void Disconnect()
+    {
+        // Before waiting for the I/O in flight, so that no new one starts meanwhile
+        bConnected.store(false, std::memory_order_release);
+        std::unique_lock Lock(DeviceMutex);
+        CloseDescriptor_Locked();
+    }
+
+    /// The device has been plugged back, possibly behind another terminal
+    ///
+    /// @param FileDevicePath Path of the terminal of the device
+    /// @param bOpenLazily Defer opening the device until it is used for the first time
+    void Reconnect(const std::string& FileDevicePath, bool bOpenLazily = false)
+    {
+        std::unique_lock Lock(DeviceMutex);
+        CloseDescriptor_Locked();
+        DevicePath = FileDevicePath;
+        bOpenFailed.store(false, std::memory_order_release);
+        bConnected.store(true, std::memory_order_release);
+        if (!bOpenLazily) {
+            OpenDevice_Locked();
+        }
+    }
+
+protected:
+    virtual int WriteToDevice_Internal(std::span<const uint8_t> Data) override
+    {
+        const std::shared_lock Lock = AcquireDevice();
+        if (DeviceFD < 0) {
+            return -1;
+        }
+        iovec Vector{
+            .iov_base = const_cast<uint8_t*>(Data.data()),
+            .iov_len = Data.size(),
+        };
+        return WriteVectors_Locked(GetCommandType(Data), std::span(&Vector, 1), GetDeadline());
+    }
+
+    virtual int WriteBatchToDevice_Internal(std::span<const std::span<const uint8_t>> Buffers) override
+    {
+        const std::shared_lock Lock = AcquireDevice();
+        if (DeviceFD < 0) {
+            return -1;
+        }
+
+        // Stay well below IOV_MAX, bigger batches are split in several calls
+        constexpr std::size_t MaxBuffers = 64;
+        std::array<iovec, MaxBuffers> Vectors;
+
+        const Clock::time_point Deadline = GetDeadline();
+        int WrittenData = 0;
+        for (std::size_t Offset = 0; Offset < Buffers.size(); Offset += MaxBuffers) {
+            const std::size_t Count = std::min(MaxBuffers, Buffers.size() - Offset);
+            for (std::size_t Index = 0; Index < Count; Index++) {
+                const std::span<const uint8_t> Buffer = Buffers[Offset + Index];
+                Vectors[Index] = iovec{
+                    .iov_base = const_cast<uint8_t*>(Buffer.data()),
+                    .iov_len = Buffer.size(),
+                };
+            }
+
+            // Batches are accounted to their first command
+            const int Result =
+                WriteVectors_Locked(GetCommandType(Buffers.front()), std::span(Vectors.data(), Count), Deadline);
+            if (Result < 0) {
+                // The split may fall in the middle of a command
+                if (WrittenData > 0) {
+                    tcflush(DeviceFD, TCOFLUSH);
+                }
+                return -1;
+            }
+            WrittenData += Result;
+        }
+        return WrittenData;
+    }
+
+    /// Read until the buffer is full, the device fails or the timeout is reached
+    ///
+    /// @return The number of bytes read, -1 if none could be
+    virtual int ReadFromDevice_Internal(std::span<uint8_t> Buffer) override
+    {
+        const std::shared_lock Lock = AcquireDevice();
+        if (DeviceFD < 0) {
+            return -1;
+        }
+
+        const Clock::time_point Deadline = GetDeadline();
+        std::size_t ReadData = 0;
+        while (ReadData < Buffer.size()) {
+            const ssize_t Result = read(DeviceFD, Buffer.data() + ReadData, Buffer.size() - ReadData);
+            Stats.RecordReadSyscall();
+            if (Result > 0) {
+                ReadData += Result;
+            } else if (Result < 0 && errno == EINTR) {
+                continue;
+            } else if (Result < 0 && errno == EAGAIN && WaitForDevice_Locked(POLLIN, Deadline)) {
+                continue;
+            } else {
+                break;
+            }
+        }
+
+        if (ReadData < Buffer.size()) {
+            // Drop what arrived of the reply, the rest of it is discarded before the next command with a reply
+            tcflush(DeviceFD, TCIFLUSH);
+        }
+        return ReadData == 0 ? -1 : static_cast<int>(ReadData);
+    }
+
+    virtual void DiscardInput_Internal() override
+    {
+        const std::shared_lock Lock = AcquireDevice();
+        if (DeviceFD >= 0) {
+            tcflush(DeviceFD, TCIFLUSH);
+        }
+    }
+
+protected:
+    /// Release the device for good, it is not valid anymore afterward
+    void CloseDevice()
+    {
+        // The writer thread must be done with the device before it is closed
+        AsyncQueue.reset();
+
+        std::unique_lock Lock(DeviceMutex);
+        bConnected.store(false, std::memory_order_release);
+        CloseDescriptor_Locked();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point GetDeadline() const
+    {
+        return Clock::now() + GetTimeout();
+    }
+
+    /// Wait for the device to be ready for the events
+    ///
+    /// @return false if the deadline is reached or the device failed
+    bool WaitForDevice_Locked(short Events, Clock::time_point Deadline) const
+    {
+        while (true) {
+            const auto Remaining = std::chrono::ceil<std::chrono::milliseconds>(Deadline - Clock::now()).count();
+            if (Remaining <= 0) {
+                return false;
+            }
+
+            pollfd Descriptor{
+                .fd = DeviceFD,
+                .events = Events,
+                .revents = 0,
+            };
+            const int Result = poll(&Descriptor, 1, static_cast<int>(Remaining));
+            if (Result < 0 && errno == EINTR) {
+                continue;
+            }
+            return Result > 0 && (Descriptor.revents & (Events | POLLHUP | POLLERR));
+        }
+    }
+
+    /// Write every buffer, waiting for room in the output of the device when it is full
+    ///
+    /// The buffers are modified to skip what has been written already
+    /// @return The number of bytes written, -1 on error or timeout, what was written being dropped from the output
+    int WriteVectors_Locked(CommandType Type, std::span<iovec> Vectors, Clock::time_point Deadline)
+    {
+        std::size_t Remaining = 0;
+        for (const iovec& Vector: Vectors) {
+            Remaining += Vector.iov_len;
+        }
+
+        int WrittenData = 0;
+        while (Remaining > 0) {
+            const ssize_t Result = writev(DeviceFD, Vectors.data(), Vectors.size());
+            Stats.RecordWriteSyscall(Type, Result >= 0 && static_cast<std::size_t>(Result) < Remaining);
+            if (Result < 0) {
+                if (errno == EINTR || (errno == EAGAIN && WaitForDevice_Locked(POLLOUT, Deadline))) {
+                    continue;
+                }
+                // The firmware would append the next command to what was sent of this one, and misparse both
+                if (WrittenData > 0) {
+                    tcflush(DeviceFD, TCOFLUSH);
+                }
+                return -1;
+            }
+
+            WrittenData += Result;
+            Remaining -= Result;
+            std::size_t Skipped = Result;
+            while (!Vectors.empty() && Skipped >= Vectors.front().iov_len) {
+                Skipped -= Vectors.front().iov_len;
+                Vectors = Vectors.subspan(1);
+            }
+            if (!Vectors.empty()) {
+                Vectors.front().iov_base = static_cast<uint8_t*>(Vectors.front().iov_base) + Skipped;
+                Vectors.front().iov_len -= Skipped;
+            }
+        }
+        return WrittenData;
+    }
+
+    /// Lock the device for I/O, opening it first if it was opened lazily
+    ///
+    /// The device may still be closed once locked, if it is unplugged or failed to open
+    std::shared_lock<std::shared_mutex> AcquireDevice()
+    {
+        {
+            std::shared_lock Lock(DeviceMutex);
+            if (DeviceFD >= 0 || !IsValid()) {
+                return Lock;
+            }
+        }
+        {
+            std::unique_lock Lock(DeviceMutex);
+            OpenDevice_Locked();
+        }
+        return std::shared_lock(DeviceMutex);
+    }
+
+    bool OpenDevice_Locked()
+    {
+        if (DeviceFD >= 0) {
+            return true;
+        }
+        if (!IsValid() || DevicePath.empty()) {
+            return false;
+        }
+        return ConfigureDevice(open(DevicePath.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK));
+    }
+
+    /// Take ownership of the terminal and configure it
+    ///
+    /// @return false if there is no terminal
+    bool ConfigureDevice(int FileDescriptor)
+    {
+        DeviceFD = FileDescriptor;
+        if (DeviceFD < 0) {
+            perror("open");
+            bOpenFailed.store(true, std::memory_order_release);
+            return false;
+        }
+
+        // Exclusive access to the device
+        if (ioctl(DeviceFD, TIOCEXCL)) {
+            perror("ioctl(TIOCEXCL)");
+            return true;
+        }
+
+        // Stay non-blocking, waiting for the device is done with poll so that it can time out
+        const int Flags = fcntl(DeviceFD, F_GETFL);
+        if (Flags < 0 || fcntl(DeviceFD, F_SETFL, Flags | O_NONBLOCK)) {
+            perror("fcntl");
+            return true;
+        }
+
+        struct termios TTYSettings;
+        if (tcgetattr(DeviceFD, &TTYSettings)) {
+            perror("tcgetattr");
+            return true;
+        }
+
+        // Set the terminal settings to be binary
+        TTYSettings.c_cflag |= CREAD | CLOCAL;
+        cfmakeraw(&TTYSettings);
+
+        if (tcsetattr(DeviceFD, TCSANOW, &TTYSettings)) {
+            perror("tcsetattr");
+            return true;
+        }
+        if (tcflush(DeviceFD, TCIOFLUSH)) {
+            perror("tcflush");
+            return true;
+        }
+
+        // Parity settings : None
+        TTYSettings.c_cflag &= !(PARENB | PARODD);
+        TTYSettings.c_iflag &= !INPCK;
+        TTYSettings.c_iflag |= IGNPAR;
+
+        // Flow control settings : None
+        TTYSettings.c_iflag &= !(IXON | IXOFF);
+        TTYSettings.c_cflag &= !CRTSCTS;
+
+        // Set data bit: 8
+        TTYSettings.c_cflag &= !CSIZE;
+        TTYSettings.c_cflag |= CS8;
+
+        // Set stop bit: 1
+        TTYSettings.c_cflag &= !CSTOPB;
+        cfsetspeed(&TTYSettings, B115200);
+        tcsetattr(DeviceFD, TCSANOW, &TTYSettings);
+        return true;
+    }
+
+    void CloseDescriptor_Locked()
+    {
+        if (DeviceFD >= 0) {
+            // Fails once the device is unplugged, nothing to worry about
+            if (ioctl(DeviceFD, TIOCNXCL) && errno != EIO) {
+                perror("ioctl(TIOCNXCL)");
+            }
+            close(DeviceFD);
+        }
+        DeviceFD = -1;
+    }
+
+private:
+    /// Guards the terminal: shared for I/O, exclusive to open or close it
+    mutable std::shared_mutex DeviceMutex;
+    int DeviceFD = -1;
+    std::string DevicePath;
+
+    std::atomic<bool> bConnected = true;
+    std::atomic<bool> bOpenFailed = false;
+    std::atomic<int> TimeoutMilliseconds = DefaultTimeout.count();
+
+    std::once_flag AsyncQueueFlag;
+    std::unique_ptr<InputModuleAsyncQueue> AsyncQueue;
+};
+
+class InputModuleManagerLinux final : public IInputModuleManager
+{
+public:
+    explicit InputModuleManagerLinux(const InputModuleManagerSettings& Settings = {})
+        : Settings(Settings), UdevContext(udev_new(), &udev_unref)
+    {
+        INPUTMODULE_ASSERT(UdevContext != nullptr);
+
+        // Start listening before enumerating, so that no device plugged in between is missed
+        if (Settings.bWatchHotplug) {
+            StartMonitor();
+        }
+
+        // We list every tty udev device
+        struct udev_enumerate* enumerate = udev_enumerate_new(UdevContext.get());
+        udev_enumerate_add_match_subsystem(enumerate, "tty");
+        udev_enumerate_scan_devices(enumerate);
+
+        std::vector<InputModuleLinux*> AddedModules;
+
+        /// Iterate over the list of devices
+        struct udev_list_entry* list = nullptr;
+        struct udev_list_entry* node = nullptr;
+        list = udev_enumerate_get_list_entry(enumerate);
+        udev_list_entry_foreach(node, list)
+        {
+            const std::string_view SysPath = udev_list_entry_get_name(node);
+            struct udev_device* const dev = udev_device_new_from_syspath(UdevContext.get(), SysPath.data());
+            if (dev == nullptr) {
+                continue;
+            }
+
+            if (InputModuleLinux* const InputModule = AddDevice(dev, true)) {
+                AddedModules.push_back(InputModule);
+            }
+            udev_device_unref(dev);
+        }
+        udev_enumerate_unref(enumerate);
+
+        if (Settings.bOpenLazily) {
+            return;
+        }
+
+        // Configuring a terminal takes a few system calls each, do all of them at once
+        std::vector<std::jthread> OpenThreads;
+        OpenThreads.reserve(AddedModules.size());
+        for (InputModuleLinux* const InputModule: AddedModules) {
+            OpenThreads.emplace_back([InputModule] { InputModule->Open(); });
+        }
+    }
+
+    virtual ~InputModuleManagerLinux()
+    {
+        if (MonitorThread.joinable()) {
+            const uint64_t Value = 1;
+            if (write(StopFD, &Value, sizeof(Value)) < 0) {
+                perror("write(eventfd)");
+            }
+            MonitorThread.join();
+        }
+        if (StopFD >= 0) {
+            close(StopFD);
+        }
+    }
+
+    virtual IInputModule* GetInputModule(InputModuleType Type, int Index = 0) override
+    {
+        std::scoped_lock Lock(ModulesMutex);
+        const auto Iter = InputModulesMap.find(Type);
+        if (Iter == InputModulesMap.end()) {
+            return nullptr;
+        }
+
+        if (Index < 0 || std::size_t(Index) >= Iter->second.size()) {
+            return nullptr;
+        }
+        return Iter->second[Index].Module.get();
+    }
+
+    virtual int IsTypeOfInputModuleAvailable(InputModuleType Type) const override
+    {
+        std::scoped_lock Lock(ModulesMutex);
+        const auto Iter = InputModulesMap.find(Type);
+        if (Iter == InputModulesMap.end()) {
+            return 0;
+        }
+        return Iter->second.size();
+    }
+
+private:
+    /// Find out which input module a tty device is
+    ///
+    /// @return The type of the input module, or nothing if it is not an input module
+    static std::optional<InputModuleType> GetInputModuleType(struct udev_device* dev)
+    {
+        const char* const VendorIDPtr = udev_device_get_property_value(dev, "ID_VENDOR_ID");
+        const char* const ModelIDPtr = udev_device_get_property_value(dev, "ID_MODEL_ID");
+        if (VendorIDPtr == nullptr || ModelIDPtr == nullptr) {
+            return std::nullopt;
+        }
+        if (std::string_view(VendorIDPtr) != "32ac") {
+            return std::nullopt;    // Not a Framework device
+        }
+
+        // USB product ids of the input modules, the serial numbers are not reliable enough to tell them apart
+        const std::string_view ModelID(ModelIDPtr);
+        if (ModelID == "0020") {
+            return InputModuleType::LEDMatrix;
+        } else if (ModelID == "0021") {
+            return InputModuleType::B1Display;
+        } else if (ModelID == "0022") {
+            return InputModuleType::C1MinimalModule;
+        }
+        return std::nullopt;
+    }
+
+    /// Register a new tty device, or reconnect the input module it was before being unplugged
+    ///
+    /// @param bDeferOpen Do not open the device, the caller takes care of it
+    /// @return The input module, nullptr if the device is not an input module
+    InputModuleLinux* AddDevice(struct udev_device* dev, bool bDeferOpen)
+    {
+        const std::optional<InputModuleType> Type = GetInputModuleType(dev);
+        if (!Type) {
+            return nullptr;
+        }
+
+        const char* const DevName = udev_device_get_property_value(dev, "DEVNAME");
+        if (DevName == nullptr || std::strlen(DevName) == 0) {
+            return nullptr;
+        }
+        const char* const SysPath = udev_device_get_syspath(dev);
+        const char* const SerialShortPtr = udev_device_get_property_value(dev, "ID_SERIAL_SHORT");
+        const std::string SerialShort(SerialShortPtr ? SerialShortPtr : "");
+
+        // The module is registered lazily, opening the terminal takes too long to block the other users of the list
+        InputModuleLinux* const InputModule = RegisterDevice(*Type, DevName, SysPath, SerialShort);
+        if (InputModule != nullptr && !bDeferOpen && !Settings.bOpenLazily) {
+            InputModule->Open();
+        }
+        return InputModule;
+    }
+
+    /// @return The input module registered, not opened yet, nullptr if it is already known
+    InputModuleLinux* RegisterDevice(InputModuleType Type, const char* DevName, const char* SysPath,
+                                     const std::string& SerialShort)
+    {
+        std::scoped_lock Lock(ModulesMutex);
+        for (DeviceEntry& Entry: InputModulesMap[Type]) {
+            const bool bSameDevice = Entry.SysPath == SysPath;
+            if (bSameDevice && Entry.Module->IsValid()) {
+                return nullptr;    // Already known, the monitor may have seen it before the enumeration
+            }
+            // A module plugged back is recognized by its serial number, as it may be behind another tty
+            const bool bReplugged =
+                !SerialShort.empty() && Entry.SerialNumber == SerialShort && !Entry.Module->IsValid();
+            if (!bSameDevice && !bReplugged) {
+                continue;
+            }
+            // Disconnected modules fail their I/O right away, reconnecting them does not wait for any
+            Entry.SysPath = SysPath;
+            Entry.Module->Reconnect(DevName, true);
+            return Entry.Module.get();
+        }
+
+        DeviceEntry& Entry = InputModulesMap[Type].emplace_back(DeviceEntry{
+            .SerialNumber = SerialShort,
+            .SysPath = SysPath,
+            .Module = std::make_unique<InputModuleLinux>(Type, DevName, true),
+        });
+        return Entry.Module.get();
+    }
+
+    /// Disconnect the input module behind an unplugged tty device
+    ///
+    /// @return The input module, nullptr if the device is not an input module
+    InputModuleLinux* RemoveDevice(struct udev_device* dev)
+    {
+        InputModuleLinux* const InputModule = FindConnectedModule(udev_device_get_syspath(dev));
+        // Waits for the I/O in flight, which may last until its timeout, so the list is not locked meanwhile
+        if (InputModule != nullptr) {
+            InputModule->Disconnect();
+        }
+        return InputModule;
+    }
+
+    /// @return The input module connected behind a tty device, nullptr if there is none
+    InputModuleLinux* FindConnectedModule(std::string_view SysPath) const
+    {
+        std::scoped_lock Lock(ModulesMutex);
+        for (const auto& [Type, InputModules]: InputModulesMap) {
+            for (const DeviceEntry& Entry: InputModules) {
+                if (Entry.SysPath == SysPath && Entry.Module->IsValid()) {
+                    return Entry.Module.get();
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void StartMonitor()
+    {
+        Monitor = UdevMonitorPtr(udev_monitor_new_from_netlink(UdevContext.get(), "udev"), &udev_monitor_unref);
+        if (Monitor == nullptr) {
+            perror("udev_monitor_new_from_netlink");
+            return;
+        }
+        udev_monitor_filter_add_match_subsystem_devtype(Monitor.get(), "tty", nullptr);
+        if (udev_monitor_enable_receiving(Monitor.get()) < 0) {
+            perror("udev_monitor_enable_receiving");
+            return;
+        }
+
+        StopFD = eventfd(0, EFD_CLOEXEC);
+        if (StopFD < 0) {
+            perror("eventfd");
+            return;
+        }
+        MonitorThread = std::jthread([this] { RunMonitor(); });
+    }
+
+    void RunMonitor()
+    {
+        while (true) {
+            std::array<struct pollfd, 2> PollFDs = {{
+                {.fd = udev_monitor_get_fd(Monitor.get()), .events = POLLIN, .revents = 0},
+                {.fd = StopFD, .events = POLLIN, .revents = 0},
+            }};
+            if (poll(PollFDs.data(), PollFDs.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("poll");
+                return;
+            }
+            if (PollFDs[1].revents) {
+                return;
+            }
+
+            struct udev_device* const dev = udev_monitor_receive_device(Monitor.get());
+            if (dev == nullptr) {
+                continue;
+            }
+
+            const std::string_view Action = udev_device_get_action(dev) ? udev_device_get_action(dev) : "";
+            if (Action == "add") {
+                if (InputModuleLinux* const InputModule = AddDevice(dev, false)) {
+                    NotifyInputModuleAdded(InputModule);
+                }
+            } else if (Action == "remove") {
+                if (InputModuleLinux* const InputModule = RemoveDevice(dev)) {
+                    NotifyInputModuleRemoved(InputModule);
+                }
+            }
+            udev_device_unref(dev);
+        }
+    }
+
+private:
+    struct DeviceEntry {
+        /// Identifies the device across replugs
+        std::string SerialNumber;
+        /// Identifies the device while it is plugged
+        std::string SysPath;
+        std::unique_ptr<InputModuleLinux> Module;
+    };
+    using InputModuleList = std::vector<DeviceEntry>;
+    using UdevPtr = std::unique_ptr<struct udev, decltype(&udev_unref)>;
+    using UdevMonitorPtr = std::unique_ptr<struct udev_monitor, decltype(&udev_monitor_unref)>;
+
+    const InputModuleManagerSettings Settings;
+
+    UdevPtr UdevContext;
+    UdevMonitorPtr Monitor = UdevMonitorPtr(nullptr, &udev_monitor_unref);
+    /// Used to wake up the monitor thread when it must stop
+    int StopFD = -1;
+    std::jthread MonitorThread;
+
+    /// Input modules are never destroyed before the manager, so the pointers given away stay valid
+    mutable std::mutex ModulesMutex;
+    std::unordered_map<InputModuleType, InputModuleList> InputModulesMap;
+};
+
+using InputModuleManager = InputModuleManagerLinux;
+
+}    // namespace framework
+
+#elif defined(INPUTMODULE_PLATFORM_WINDOWS)
+
+namespace framework
+{
+
+class InputModuleManagerWindows final : public IInputModuleManager
+{
+public:
+    explicit InputModuleManagerWindows(const InputModuleManagerSettings& Settings = {})
+    {
+    }
+
+    virtual IInputModule* GetInputModule(InputModuleType Type, int Index = 0) override
+    {
+        assert(false && "Not implemented");
+        return nullptr;
     }
 
     virtual int IsTypeOfInputModuleAvailable(InputModuleType Type) const override
@@ -695,6 +2062,12 @@ public:
         assert(false && "Not implemented");
         return 0;
     }
+
+    virtual std::vector<InputModuleStats> GetStats() override
+    {
+        // No input module yet
+        return {};
+    }
 };
 
 using InputModuleManager = InputModuleManagerWindows;
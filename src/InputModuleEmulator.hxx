@@ -0,0 +1,486 @@
+#pragma once
+
+#include "InputModule.hxx"
+
+#if defined(INPUTMODULE_PLATFORM_LINUX)
+
+    #include <algorithm>
+    #include <array>
+    #include <atomic>
+    #include <chrono>
+    #include <cstdint>
+    #include <cstring>
+    #include <mutex>
+    #include <optional>
+    #include <span>
+    #include <thread>
+    #include <vector>
+
+    #include <poll.h>
+    #include <pty.h>
+    #include <sys/eventfd.h>
+    #include <termios.h>
+    #include <unistd.h>
+
+namespace framework
+{
+
+/// @brief Emulation of the input module firmware
+///
+/// The emulator owns the master side of a pseudo terminal and answers on its own thread, the slave side being used
+/// as if it were the serial port of a real device. It understands the framed commands, keeps the state of the device
+/// and sends back the 32 bytes replies.
+///
+/// The pseudo terminal does not keep the boundaries of the writes, so commands whose argument is optional (like
+/// Brightness / GetBrightness) are told apart by looking at what follows them.
+class InputModuleFirmwareEmulator
+{
+public:
+    static constexpr int LEDMatrixWidth = 9;
+    static constexpr int LEDMatrixHeight = 34;
+    using LEDMatrixGrid = std::array<std::array<uint8_t, LEDMatrixHeight>, LEDMatrixWidth>;
+
+    static constexpr int B1DisplayWidth = 300;
+    static constexpr int B1DisplayHeight = 400;
+    /// Columns packed 1 bit per pixel, as sent by SetPxColor
+    using B1DisplayFramebuffer = std::vector<std::array<uint8_t, B1DisplayHeight / 8>>;
+
+    /// Time needed to transmit a byte at 115200 bauds (8 data bits, 1 start bit and 1 stop bit)
+    static constexpr std::chrono::nanoseconds ByteTime = std::chrono::nanoseconds(1'000'000'000 / (115200 / 10));
+
+    /// Version reported by the emulated firmware
+    static constexpr Commands::Version::Reply Version = {
+        .Major = 0,
+        .MinorPatch = 0x20,
+        .PreRelease = false,
+    };
+
+public:
+    /// @param Type The type of input module to emulate
+    /// @param bSimulateBaudRate Slow down the emulator to the throughput of a 115200 bauds serial link
+    explicit InputModuleFirmwareEmulator(InputModuleType Type, bool bSimulateBaudRate = false)
+        : Type(Type), bSimulateBaudRate(bSimulateBaudRate)
+    {
+        struct termios TTYSettings = {};
+        cfmakeraw(&TTYSettings);
+        if (openpty(&MasterFD, &SlaveFD, nullptr, &TTYSettings, nullptr)) {
+            perror("openpty");
+            MasterFD = -1;
+            SlaveFD = -1;
+            return;
+        }
+
+        StopFD = eventfd(0, EFD_CLOEXEC);
+        if (StopFD < 0) {
+            perror("eventfd");
+            return;
+        }
+
+        EmulatorThread = std::jthread([this] { Run(); });
+    }
+
+    ~InputModuleFirmwareEmulator()
+    {
+        if (EmulatorThread.joinable()) {
+            const uint64_t Value = 1;
+            if (write(StopFD, &Value, sizeof(Value)) < 0) {
+                perror("write(eventfd)");
+            }
+            EmulatorThread.join();
+        }
+
+        for (const int FileDescriptor: {StopFD, SlaveFD, MasterFD}) {
+            if (FileDescriptor >= 0) {
+                close(FileDescriptor);
+            }
+        }
+    }
+
+    InputModuleFirmwareEmulator(const InputModuleFirmwareEmulator&) = delete;
+    InputModuleFirmwareEmulator& operator=(const InputModuleFirmwareEmulator&) = delete;
+
+    bool IsValid() const
+    {
+        return MasterFD >= 0 && StopFD >= 0;
+    }
+
+    InputModuleType GetType() const
+    {
+        return Type;
+    }
+
+    /// Give away the host side of the pseudo terminal
+    ///
+    /// @return The file descriptor of the terminal, to be closed by the caller. -1 if it was already released
+    int ReleaseDeviceFD()
+    {
+        const int FileDescriptor = SlaveFD;
+        SlaveFD = -1;
+        return FileDescriptor;
+    }
+
+    /// Number of commands handled since the creation of the emulator
+    uint64_t GetCommandCount() const
+    {
+        return CommandCount.load(std::memory_order_acquire);
+    }
+
+    /// Number of bytes received since the creation of the emulator
+    uint64_t GetReceivedBytes() const
+    {
+        return ReceivedBytes.load(std::memory_order_acquire);
+    }
+
+    uint8_t GetBrightness() const
+    {
+        std::scoped_lock Lock(StateMutex);
+        return Brightness;
+    }
+
+    bool IsSleeping() const
+    {
+        std::scoped_lock Lock(StateMutex);
+        return bSleeping;
+    }
+
+    bool IsAnimating() const
+    {
+        std::scoped_lock Lock(StateMutex);
+        return bAnimating;
+    }
+
+    PatternType GetPattern() const
+    {
+        std::scoped_lock Lock(StateMutex);
+        return Pattern;
+    }
+
+    /// Pixels displayed by the LED Matrix, column by column
+    LEDMatrixGrid GetGrid() const
+    {
+        std::scoped_lock Lock(StateMutex);
+        return Grid;
+    }
+
+    bool IsDisplayOn() const
+    {
+        std::scoped_lock Lock(StateMutex);
+        return bDisplayOn;
+    }
+
+    bool IsScreenInverted() const
+    {
+        std::scoped_lock Lock(StateMutex);
+        return bScreenInverted;
+    }
+
+    /// Is a pixel displayed by the B1 Display on
+    bool GetB1Pixel(int X, int Y) const
+    {
+        INPUTMODULE_ASSERT(X >= 0 && X < B1DisplayWidth && Y >= 0 && Y < B1DisplayHeight);
+        std::scoped_lock Lock(StateMutex);
+        return B1Displayed[X][Y / 8] & (1 << (Y % 8));
+    }
+
+private:
+    struct CommandLayout {
+        std::size_t MinArguments = 0;
+        std::size_t MaxArguments = 0;
+    };
+
+    static std::optional<CommandLayout> GetLayout(CommandType Command)
+    {
+        switch (Command) {
+            case CommandType::Brightness: return CommandLayout{0, 1};
+            case CommandType::Pattern: return CommandLayout{1, 2};
+            case CommandType::Bootloader: return CommandLayout{0, 0};
+            case CommandType::Sleep: return CommandLayout{0, 1};
+            case CommandType::Animate: return CommandLayout{0, 1};
+            case CommandType::Panic: return CommandLayout{0, 0};
+            case CommandType::DrawBW: return CommandLayout{39, 39};
+            case CommandType::StageCol: return CommandLayout{35, 35};
+            case CommandType::FlushCol: return CommandLayout{0, 0};
+            case CommandType::StartGame: return CommandLayout{1, 2};
+            case CommandType::GameControl: return CommandLayout{1, 1};
+            case CommandType::GameStatus: return CommandLayout{0, 0};
+            case CommandType::SetColor: return CommandLayout{3, 3};
+            case CommandType::DisplayOn: return CommandLayout{0, 1};
+            case CommandType::InvertScreen: return CommandLayout{0, 1};
+            case CommandType::SetPxColor: return CommandLayout{52, 52};
+            case CommandType::FlushFB: return CommandLayout{0, 0};
+            case CommandType::Version: return CommandLayout{0, 0};
+        }
+        return std::nullopt;
+    }
+
+    static bool IsHeader(std::span<const uint8_t> Data)
+    {
+        const Commands::PayloadHeader Header{};
+        return Data.size() >= 2 && Data[0] == Header.Magic1 && Data[1] == Header.Magic2;
+    }
+
+    bool IsMoreDataAvailable() const
+    {
+        struct pollfd PollFD = {.fd = MasterFD, .events = POLLIN, .revents = 0};
+        return poll(&PollFD, 1, 0) > 0 && (PollFD.revents & POLLIN);
+    }
+
+    void Run()
+    {
+        std::array<uint8_t, 4096> ReadBuffer;
+        auto NextByteTime = std::chrono::steady_clock::now();
+
+        while (true) {
+            std::array<struct pollfd, 2> PollFDs = {{
+                {.fd = MasterFD, .events = POLLIN, .revents = 0},
+                {.fd = StopFD, .events = POLLIN, .revents = 0},
+            }};
+            if (poll(PollFDs.data(), PollFDs.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("poll");
+                return;
+            }
+            if (PollFDs[1].revents) {
+                return;
+            }
+            if (!(PollFDs[0].revents & POLLIN)) {
+                // The host closed its side of the terminal
+                return;
+            }
+
+            const ssize_t ReadData = read(MasterFD, ReadBuffer.data(), ReadBuffer.size());
+            if (ReadData <= 0) {
+                return;
+            }
+            ReceivedBytes.fetch_add(ReadData, std::memory_order_release);
+
+            if (bSimulateBaudRate) {
+                NextByteTime = std::max(NextByteTime, std::chrono::steady_clock::now()) + ReadData * ByteTime;
+                std::this_thread::sleep_until(NextByteTime);
+            }
+
+            Pending.insert(Pending.end(), ReadBuffer.begin(), ReadBuffer.begin() + ReadData);
+            ParsePending();
+        }
+    }
+
+    /// Handle every complete command waiting in the pending buffer
+    void ParsePending()
+    {
+        const std::size_t HeaderSize = sizeof(Commands::PayloadHeader);
+
+        std::size_t Offset = 0;
+        while (Pending.size() - Offset >= HeaderSize) {
+            const std::span<const uint8_t> Data = std::span(Pending).subspan(Offset);
+            if (!IsHeader(Data)) {
+                // Padding, or garbage
+                Offset++;
+                continue;
+            }
+
+            const CommandType Command = static_cast<CommandType>(Data[2]);
+            const std::optional<CommandLayout> Layout = GetLayout(Command);
+            if (!Layout) {
+                Offset += HeaderSize;
+                continue;
+            }
+            if (Data.size() < HeaderSize + Layout->MinArguments) {
+                break;
+            }
+
+            // An optional argument cut by the end of the read would be mistaken for its absence
+            if (Data.size() == HeaderSize + Layout->MinArguments && Layout->MaxArguments > Layout->MinArguments &&
+                IsMoreDataAvailable()) {
+                break;
+            }
+
+            std::size_t ArgumentCount = Layout->MinArguments;
+            while (ArgumentCount < Layout->MaxArguments && Data.size() > HeaderSize + ArgumentCount &&
+                   !IsHeader(Data.subspan(HeaderSize + ArgumentCount))) {
+                ArgumentCount++;
+            }
+
+            HandleCommand(Command, Data.subspan(HeaderSize, ArgumentCount));
+            Offset += HeaderSize + ArgumentCount;
+        }
+        Pending.erase(Pending.begin(), Pending.begin() + Offset);
+    }
+
+    void HandleCommand(CommandType Command, std::span<const uint8_t> Arguments)
+    {
+        std::array<uint8_t, IInputModule::ReplySize> Reply = {};
+        bool bHasReply = false;
+
+        {
+            std::scoped_lock Lock(StateMutex);
+            switch (Command) {
+                case CommandType::Brightness:
+                    if (Arguments.empty()) {
+                        Reply[0] = Brightness;
+                        bHasReply = true;
+                    } else {
+                        Brightness = Arguments[0];
+                    }
+                    break;
+                case CommandType::Pattern: Pattern = static_cast<PatternType>(Arguments[0]); break;
+                case CommandType::Sleep:
+                    if (Arguments.empty()) {
+                        Reply[0] = bSleeping;
+                        bHasReply = true;
+                    } else {
+                        bSleeping = Arguments[0];
+                    }
+                    break;
+                case CommandType::Animate:
+                    if (Arguments.empty()) {
+                        Reply[0] = bAnimating;
+                        bHasReply = true;
+                    } else {
+                        bAnimating = Arguments[0];
+                    }
+                    break;
+                case CommandType::DrawBW:
+                    for (int Index = 0; Index < LEDMatrixWidth * LEDMatrixHeight; Index++) {
+                        const bool bOn = Arguments[Index / 8] & (1 << (Index % 8));
+                        Grid[Index % LEDMatrixWidth][Index / LEDMatrixWidth] = bOn ? 0xFF : 0x00;
+                    }
+                    break;
+                case CommandType::StageCol:
+                    if (Arguments[0] < LEDMatrixWidth) {
+                        std::memcpy(ColumnBuffer[Arguments[0]].data(), &Arguments[1], LEDMatrixHeight);
+                    }
+                    break;
+                case CommandType::FlushCol:
+                    Grid = ColumnBuffer;
+                    ColumnBuffer = {};
+                    break;
+                case CommandType::DisplayOn:
+                    if (Arguments.empty()) {
+                        Reply[0] = bDisplayOn;
+                        bHasReply = true;
+                    } else {
+                        bDisplayOn = Arguments[0];
+                    }
+                    break;
+                case CommandType::InvertScreen:
+                    if (Arguments.empty()) {
+                        Reply[0] = bScreenInverted;
+                        bHasReply = true;
+                    } else {
+                        bScreenInverted = Arguments[0];
+                    }
+                    break;
+                case CommandType::SetPxColor: {
+                    // Same layout as Commands::SetPxColor, the column being little endian
+                    const uint16_t Column = Arguments[0] | (Arguments[1] << 8);
+                    if (Column < B1DisplayWidth) {
+                        std::memcpy(B1Framebuffer[Column].data(), &Arguments[sizeof(Commands::SetPxColor::Col)],
+                                    sizeof(Commands::SetPxColor::ColorData));
+                    }
+                    break;
+                }
+                case CommandType::FlushFB: B1Displayed = B1Framebuffer; break;
+                case CommandType::Version:
+                    std::memcpy(Reply.data(), &Version, sizeof(Version));
+                    bHasReply = true;
+                    break;
+                default: break;
+            }
+        }
+
+        // Counted before replying, so that every command up to one with a reply is counted once the reply is read
+        CommandCount.fetch_add(1, std::memory_order_release);
+        if (bHasReply) {
+            SendReply(Reply);
+        }
+    }
+
+    void SendReply(std::span<const uint8_t> Reply)
+    {
+        if (bSimulateBaudRate) {
+            std::this_thread::sleep_for(Reply.size() * ByteTime);
+        }
+
+        std::size_t Offset = 0;
+        while (Offset < Reply.size()) {
+            const ssize_t Written = write(MasterFD, Reply.data() + Offset, Reply.size() - Offset);
+            if (Written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("write");
+                return;
+            }
+            Offset += Written;
+        }
+    }
+
+private:
+    const InputModuleType Type;
+    const bool bSimulateBaudRate = false;
+
+    int MasterFD = -1;
+    int SlaveFD = -1;
+    /// Used to wake up the emulator thread when it must stop
+    int StopFD = -1;
+
+    /// Received bytes not parsed yet, only used by the emulator thread
+    std::vector<uint8_t> Pending;
+
+    std::atomic<uint64_t> CommandCount = 0;
+    std::atomic<uint64_t> ReceivedBytes = 0;
+
+    mutable std::mutex StateMutex;
+    uint8_t Brightness = 51;
+    bool bSleeping = false;
+    bool bAnimating = false;
+    PatternType Pattern = PatternType::Percentage;
+    LEDMatrixGrid Grid = {};
+    LEDMatrixGrid ColumnBuffer = {};
+    bool bDisplayOn = true;
+    bool bScreenInverted = false;
+    B1DisplayFramebuffer B1Framebuffer = B1DisplayFramebuffer(B1DisplayWidth);
+    B1DisplayFramebuffer B1Displayed = B1DisplayFramebuffer(B1DisplayWidth);
+
+    std::jthread EmulatorThread;
+};
+
+/// @brief Input module talking to an in-process firmware emulator
+///
+/// Behave exactly like a real device on Linux, the emulator answering on the other side of a pseudo terminal
+class InputModuleEmulated final : public InputModuleLinux
+{
+public:
+    /// @param Type The type of input module to emulate
+    /// @param bSimulateBaudRate Slow down the emulator to the throughput of a 115200 bauds serial link
+    explicit InputModuleEmulated(InputModuleType Type, bool bSimulateBaudRate = false)
+        : InputModuleEmulated(Type, std::make_unique<InputModuleFirmwareEmulator>(Type, bSimulateBaudRate))
+    {
+    }
+
+    virtual ~InputModuleEmulated()
+    {
+        // The terminal must be released before the emulator closes the other side
+        CloseDevice();
+    }
+
+    const InputModuleFirmwareEmulator& GetFirmware() const
+    {
+        return *Firmware;
+    }
+
+private:
+    InputModuleEmulated(InputModuleType Type, std::unique_ptr<InputModuleFirmwareEmulator> Emulator)
+        : InputModuleLinux(Type, Emulator->ReleaseDeviceFD()), Firmware(std::move(Emulator))
+    {
+    }
+
+private:
+    std::unique_ptr<InputModuleFirmwareEmulator> Firmware;
+};
+
+}    // namespace framework
+
+#endif    // INPUTMODULE_PLATFORM_LINUX
@@ -0,0 +1,652 @@
+#pragma once
+
+#include "InputModule.hxx"
+
+#if defined(INPUTMODULE_PLATFORM_LINUX)
+
+    #include <algorithm>
+    #include <array>
+    #include <atomic>
+    #include <cerrno>
+    #include <chrono>
+    #include <coroutine>
+    #include <cstdint>
+    #include <cstring>
+    #include <deque>
+    #include <exception>
+    #include <memory>
+    #include <optional>
+    #include <span>
+    #include <utility>
+    #include <vector>
+
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <termios.h>
+    #include <unistd.h>
+
+namespace framework
+{
+
+class InputModuleReactor;
+
+/// @brief Coroutine run by an InputModuleReactor
+///
+/// A task starts suspended, it runs once given to InputModuleReactor::Spawn or when awaited by another task
+class InputModuleTask
+{
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    /// Resume the task awaiting this one, if any, once it is done
+    struct FinalAwaiter {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(Handle Coroutine) noexcept
+        {
+            const std::coroutine_handle<> Continuation = Coroutine.promise().Continuation;
+            return Continuation ? Continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    struct promise_type {
+        InputModuleTask get_return_object()
+        {
+            return InputModuleTask(Handle::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        FinalAwaiter final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const
+        {
+        }
+
+        void unhandled_exception()
+        {
+            Exception = std::current_exception();
+        }
+
+        std::coroutine_handle<> Continuation;
+        std::exception_ptr Exception;
+    };
+
+public:
+    InputModuleTask(InputModuleTask&& Other) noexcept: Coroutine(std::exchange(Other.Coroutine, nullptr))
+    {
+    }
+
+    InputModuleTask& operator=(InputModuleTask&& Other) noexcept
+    {
+        if (this != &Other) {
+            if (Coroutine) {
+                Coroutine.destroy();
+            }
+            Coroutine = std::exchange(Other.Coroutine, nullptr);
+        }
+        return *this;
+    }
+
+    ~InputModuleTask()
+    {
+        if (Coroutine) {
+            Coroutine.destroy();
+        }
+    }
+
+    bool IsDone() const
+    {
+        return !Coroutine || Coroutine.done();
+    }
+
+    /// Run the task from another task, rethrowing what escaped it
+    auto operator co_await() const noexcept
+    {
+        struct Awaiter {
+            Handle Coroutine;
+
+            bool await_ready() const noexcept
+            {
+                return !Coroutine || Coroutine.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> Awaiting) noexcept
+            {
+                Coroutine.promise().Continuation = Awaiting;
+                return Coroutine;
+            }
+
+            void await_resume() const
+            {
+                if (Coroutine && Coroutine.promise().Exception) {
+                    std::rethrow_exception(Coroutine.promise().Exception);
+                }
+            }
+        };
+        return Awaiter{Coroutine};
+    }
+
+private:
+    friend class InputModuleReactor;
+
+    explicit InputModuleTask(Handle Coroutine): Coroutine(Coroutine)
+    {
+    }
+
+    Handle Coroutine;
+};
+
+/// @brief Input module attached to an InputModuleReactor
+///
+/// Commands are written and their replies read by the thread of the reactor, one command at a time in the order they
+/// were sent, without ever blocking. A command not done by its deadline fails. What the device sends outside of a reply
+/// is discarded, and so is any pending input before a command with a reply is written, so that a late reply is never
+/// taken for the reply of the next command.
+class InputModuleReactorDevice
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// A command in flight, kept in the frame of the coroutine awaiting it
+    struct Request {
+        std::array<uint8_t, InputModuleAsyncQueue::MaxPayloadSize> Data;
+        uint8_t Size = 0;
+        uint8_t Written = 0;
+        std::array<uint8_t, IInputModule::ReplySize> Reply;
+        uint8_t ReplySize = 0;
+        uint8_t ReplyRead = 0;
+
+        Clock::time_point Deadline;
+        InputModuleStatsCollector::TimePoint Start;
+        std::coroutine_handle<> Waiter;
+        bool bDone = false;
+        bool bSucceeded = false;
+    };
+
+    /// Awaiting it sends the command, and gives the reply (nothing on error or timeout) or whether it was written
+    template <typename T>
+    class SendAwaiter
+    {
+    public:
+        SendAwaiter(InputModuleReactorDevice& Device, const T& Data, std::chrono::milliseconds Timeout)
+            : Device(Device)
+        {
+            static_assert(sizeof(T) <= InputModuleAsyncQueue::MaxPayloadSize);
+            std::memcpy(Pending.Data.data(), &Data, sizeof(T));
+            Pending.Size = sizeof(T);
+            if constexpr (TInputModulePayloadTypeWithReply<T>) {
+                Pending.ReplySize = IInputModule::ReplySize;
+            }
+            Pending.Deadline = Clock::now() + Timeout;
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> Awaiting)
+        {
+            Pending.Waiter = Awaiting;
+            return Device.Submit(Pending);
+        }
+
+        auto await_resume() const
+        {
+            if constexpr (TInputModulePayloadTypeWithReply<T>) {
+                if (!Pending.bSucceeded) {
+                    return std::optional<typename T::Reply>();
+                }
+                typename T::Reply ReplyData;
+                std::memcpy(&ReplyData, Pending.Reply.data(), sizeof(typename T::Reply));
+                return std::optional<typename T::Reply>(ReplyData);
+            } else {
+                return Pending.bSucceeded;
+            }
+        }
+
+    private:
+        InputModuleReactorDevice& Device;
+        Request Pending;
+    };
+
+public:
+    InputModuleReactorDevice(InputModuleReactor& Reactor, IInputModule& Module, int FileDescriptor)
+        : Reactor(Reactor), Module(Module), DeviceFD(FileDescriptor)
+    {
+    }
+
+    ~InputModuleReactorDevice()
+    {
+        if (DeviceFD >= 0) {
+            close(DeviceFD);
+        }
+    }
+
+    InputModuleReactorDevice(const InputModuleReactorDevice&) = delete;
+    InputModuleReactorDevice& operator=(const InputModuleReactorDevice&) = delete;
+
+    IInputModule& GetModule() const
+    {
+        return Module;
+    }
+
+    /// Has the device failed, every command fails afterward
+    bool HasFailed() const
+    {
+        return bFailed;
+    }
+
+    /// Send a command to the device, with the timeout of the input module unless given one
+    ///
+    /// Must be awaited from a task run by the reactor: `co_await Device->Send<Commands::Version>()`
+    template <typename T>
+    requires TInputModulePayloadType<T>
+    SendAwaiter<T> Send(const T& Data = {}, std::optional<std::chrono::milliseconds> Timeout = std::nullopt)
+    {
+        return SendAwaiter<T>(*this, Data, Timeout.value_or(Module.GetTimeout()));
+    }
+
+private:
+    friend class InputModuleReactor;
+
+    /// Queue a request, and start it right away if the device is idle
+    ///
+    /// @return false if the request is already done, the awaiting coroutine then goes on without suspending
+    bool Submit(Request& Pending)
+    {
+        Pending.Start = InputModuleStatsCollector::Now();
+        if (bFailed) {
+            Module.Stats.RecordError(GetType(Pending));
+            return false;
+        }
+
+        Queue.push_back(&Pending);
+        Submitting = &Pending;
+        Progress();
+        Submitting = nullptr;
+        return !Pending.bDone;
+    }
+
+    /// Move the requests forward as far as the device allows without blocking
+    void Progress()
+    {
+        while (!Queue.empty() && !bFailed) {
+            Request& Head = *Queue.front();
+
+            if (Head.Written == 0 && Head.ReplySize > 0) {
+                // A reply arriving after its command timed out would be taken for the reply of this one
+                tcflush(DeviceFD, TCIFLUSH);
+            }
+            while (Head.Written < Head.Size) {
+                const ssize_t Result = write(DeviceFD, Head.Data.data() + Head.Written, Head.Size - Head.Written);
+                Module.Stats.RecordWriteSyscall(GetType(Head), Result >= 0 && Result < Head.Size - Head.Written);
+                if (Result >= 0) {
+                    Head.Written += Result;
+                    if (Head.Written == Head.Size) {
+                        Module.Stats.RecordWriteLatency(Head.Start);
+                        Module.Stats.RecordCommand(GetType(Head), Head.Size);
+                    }
+                } else if (errno == EAGAIN) {
+                    return;
+                } else if (errno != EINTR) {
+                    Fail();
+                    return;
+                }
+            }
+
+            Module.Stats.SetPendingReply(GetType(Head));
+            while (Head.ReplyRead < Head.ReplySize) {
+                const ssize_t Result =
+                    read(DeviceFD, Head.Reply.data() + Head.ReplyRead, Head.ReplySize - Head.ReplyRead);
+                Module.Stats.RecordReadSyscall();
+                if (Result > 0) {
+                    Head.ReplyRead += Result;
+                } else if (Result < 0 && errno == EAGAIN) {
+                    return;
+                } else if (Result == 0 || errno != EINTR) {
+                    Fail();
+                    return;
+                }
+            }
+            if (Head.ReplySize > 0) {
+                Module.Stats.RecordReplyLatency(Head.Start);
+            }
+
+            Queue.pop_front();
+            Complete(Head, true);
+        }
+    }
+
+    /// Fail the requests whose deadline is reached
+    void Expire(Clock::time_point Now)
+    {
+        bool bFlush = false;
+        for (auto Iter = Queue.begin(); Iter != Queue.end();) {
+            Request& Pending = **Iter;
+            if (Pending.Deadline > Now) {
+                ++Iter;
+                continue;
+            }
+
+            // The device may still answer a command that started, drop what it sent and what is left to send
+            bFlush |= Pending.Written > 0;
+            Iter = Queue.erase(Iter);
+            Module.Stats.RecordError(GetType(Pending));
+            Complete(Pending, false);
+        }
+
+        if (bFlush) {
+            tcflush(DeviceFD, TCIOFLUSH);
+            Progress();
+        }
+    }
+
+    /// Earliest deadline of the requests, if any
+    std::optional<Clock::time_point> GetNextDeadline() const
+    {
+        std::optional<Clock::time_point> Next;
+        for (const Request* const Pending: Queue) {
+            if (!Next || Pending->Deadline < *Next) {
+                Next = Pending->Deadline;
+            }
+        }
+        return Next;
+    }
+
+    /// The device is gone or broken, fail everything
+    void Fail()
+    {
+        bFailed = true;
+        while (!Queue.empty()) {
+            Request& Pending = *Queue.front();
+            Queue.pop_front();
+            Module.Stats.RecordError(GetType(Pending));
+            Complete(Pending, false);
+        }
+    }
+
+    /// Read and drop what the device sends while no reply is expected, like the late reply of a timed out command
+    void Drain()
+    {
+        if (!Queue.empty() || bFailed) {
+            return;
+        }
+
+        std::array<uint8_t, IInputModule::ReplySize> Discarded;
+        while (true) {
+            const ssize_t Result = read(DeviceFD, Discarded.data(), Discarded.size());
+            if (Result > 0 || (Result < 0 && errno == EINTR)) {
+                continue;
+            }
+            if (Result == 0 || errno != EAGAIN) {
+                bFailed = true;
+            }
+            return;
+        }
+    }
+
+    void Complete(Request& Pending, bool bSucceeded);
+
+    static CommandType GetType(const Request& Pending)
+    {
+        return IInputModule::GetCommandType(std::span(Pending.Data.data(), Pending.Size));
+    }
+
+private:
+    InputModuleReactor& Reactor;
+    IInputModule& Module;
+    const int DeviceFD = -1;
+
+    /// Requests in the order they are sent, the first one being in flight
+    std::deque<Request*> Queue;
+    /// Request being submitted, it does not need to be resumed when done right away
+    Request* Submitting = nullptr;
+    bool bFailed = false;
+};
+
+/// @brief Single threaded event loop driving any number of input modules
+///
+/// Every attached device is non-blocking and registered to a single epoll instance. Tasks send commands with
+/// co_await and are resumed by the thread running the reactor when the command is done, so a slow or dead device
+/// only holds up the tasks waiting on it.
+///
+/// The reactor is not thread safe, apart from Stop. It should not be mixed with the blocking WriteToDevice calls or
+/// the asynchronous queue of the same input modules.
+class InputModuleReactor
+{
+public:
+    using Clock = InputModuleReactorDevice::Clock;
+
+public:
+    InputModuleReactor()
+    {
+        EpollFD = epoll_create1(EPOLL_CLOEXEC);
+        if (EpollFD < 0) {
+            perror("epoll_create1");
+            return;
+        }
+
+        WakeFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (WakeFD < 0) {
+            perror("eventfd");
+            return;
+        }
+        epoll_event Event{
+            .events = EPOLLIN,
+            .data = {.ptr = nullptr},
+        };
+        if (epoll_ctl(EpollFD, EPOLL_CTL_ADD, WakeFD, &Event)) {
+            perror("epoll_ctl");
+        }
+    }
+
+    ~InputModuleReactor()
+    {
+        // Suspended tasks are destroyed without being resumed, before the devices holding their requests
+        Tasks.clear();
+        Devices.clear();
+        if (WakeFD >= 0) {
+            close(WakeFD);
+        }
+        if (EpollFD >= 0) {
+            close(EpollFD);
+        }
+    }
+
+    InputModuleReactor(const InputModuleReactor&) = delete;
+    InputModuleReactor& operator=(const InputModuleReactor&) = delete;
+
+    bool IsValid() const
+    {
+        return EpollFD >= 0 && WakeFD >= 0;
+    }
+
+    /// Attach an input module to the reactor, which does its I/O on its own descriptor of the device
+    ///
+    /// @return The device to send commands to, owned by the reactor, nullptr on error or if the input module has no
+    /// descriptor
+    InputModuleReactorDevice* Attach(IInputModule& Module)
+    {
+        const int FileDescriptor = Module.DuplicateDescriptor();
+        if (FileDescriptor < 0) {
+            return nullptr;
+        }
+
+        std::unique_ptr<InputModuleReactorDevice> Device =
+            std::make_unique<InputModuleReactorDevice>(*this, Module, FileDescriptor);
+        epoll_event Event{
+            .events = EPOLLIN | EPOLLOUT | EPOLLET,
+            .data = {.ptr = Device.get()},
+        };
+        if (epoll_ctl(EpollFD, EPOLL_CTL_ADD, FileDescriptor, &Event)) {
+            perror("epoll_ctl");
+            return nullptr;
+        }
+        return Devices.emplace_back(std::move(Device)).get();
+    }
+
+    /// Start a task, it runs on the thread of the reactor
+    void Spawn(InputModuleTask Task)
+    {
+        if (Task.IsDone()) {
+            return;
+        }
+        Ready.push_back(Task.Coroutine);
+        Tasks.push_back(std::move(Task));
+    }
+
+    /// Run until every task is done, or Stop is called
+    ///
+    /// A Stop called before Run makes it return right away. An exception escaping a task is rethrown from here
+    void Run()
+    {
+        while (true) {
+            ResumeReady();
+            if (bStopping.exchange(false, std::memory_order_relaxed) || Tasks.empty()) {
+                return;
+            }
+            Poll(GetWaitTime(std::nullopt));
+        }
+    }
+
+    /// Handle the events of the devices once, waiting for them at most the given time
+    void RunOnce(std::chrono::milliseconds Timeout)
+    {
+        ResumeReady();
+        Poll(GetWaitTime(Timeout));
+        ResumeReady();
+    }
+
+    /// Make Run return, or the next call to Run if it is not running, can be called from any thread
+    void Stop()
+    {
+        bStopping.store(true, std::memory_order_relaxed);
+        const uint64_t Value = 1;
+        if (write(WakeFD, &Value, sizeof(Value)) < 0) {
+            perror("write");
+        }
+    }
+
+private:
+    friend class InputModuleReactorDevice;
+
+    /// Resume the tasks whose command is done, and forget the tasks that are done
+    void ResumeReady()
+    {
+        while (!Ready.empty()) {
+            const std::coroutine_handle<> Coroutine = Ready.front();
+            Ready.pop_front();
+            Coroutine.resume();
+        }
+
+        std::exception_ptr Exception;
+        std::erase_if(Tasks, [&Exception](const InputModuleTask& Task) {
+            if (!Task.IsDone()) {
+                return false;
+            }
+            if (!Exception) {
+                Exception = Task.Coroutine.promise().Exception;
+            }
+            return true;
+        });
+        if (Exception) {
+            std::rethrow_exception(Exception);
+        }
+    }
+
+    /// Time to wait for events, up to the next deadline
+    ///
+    /// @return The time in milliseconds, -1 to wait forever
+    int GetWaitTime(std::optional<std::chrono::milliseconds> Timeout) const
+    {
+        std::optional<Clock::time_point> Next;
+        if (Timeout) {
+            Next = Clock::now() + *Timeout;
+        }
+        for (const std::unique_ptr<InputModuleReactorDevice>& Device: Devices) {
+            const std::optional<Clock::time_point> Deadline = Device->GetNextDeadline();
+            if (Deadline && (!Next || *Deadline < *Next)) {
+                Next = Deadline;
+            }
+        }
+        if (!Next) {
+            return -1;
+        }
+        return static_cast<int>(
+            std::max<int64_t>(0, std::chrono::ceil<std::chrono::milliseconds>(*Next - Clock::now()).count()));
+    }
+
+    void Poll(int TimeoutMilliseconds)
+    {
+        std::array<epoll_event, 32> Events;
+        const int Count = epoll_wait(EpollFD, Events.data(), Events.size(), TimeoutMilliseconds);
+        if (Count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+        }
+
+        for (int Index = 0; Index < Count; Index++) {
+            InputModuleReactorDevice* const Device = static_cast<InputModuleReactorDevice*>(Events[Index].data.ptr);
+            if (Device == nullptr) {
+                uint64_t Value;
+                while (read(WakeFD, &Value, sizeof(Value)) > 0) {
+                }
+                continue;
+            }
+
+            // A device gone may still have data to read, reading it finds out the error
+            if ((Events[Index].events & (EPOLLERR | EPOLLHUP)) && !(Events[Index].events & EPOLLIN)) {
+                Device->Fail();
+            } else {
+                Device->Progress();
+                if (Events[Index].events & EPOLLIN) {
+                    Device->Drain();
+                }
+            }
+        }
+
+        const Clock::time_point Now = Clock::now();
+        for (const std::unique_ptr<InputModuleReactorDevice>& Device: Devices) {
+            Device->Expire(Now);
+        }
+    }
+
+private:
+    int EpollFD = -1;
+    /// Wakes up epoll_wait when stopping
+    int WakeFD = -1;
+    std::atomic<bool> bStopping = false;
+
+    std::vector<std::unique_ptr<InputModuleReactorDevice>> Devices;
+    std::vector<InputModuleTask> Tasks;
+    /// Coroutines to resume, their command being done
+    std::deque<std::coroutine_handle<>> Ready;
+};
+
+inline void InputModuleReactorDevice::Complete(Request& Pending, bool bSucceeded)
+{
+    Pending.bDone = true;
+    Pending.bSucceeded = bSucceeded;
+    if (&Pending != Submitting) {
+        Reactor.Ready.push_back(Pending.Waiter);
+    }
+}
+
+}    // namespace framework
+
+#endif    // INPUTMODULE_PLATFORM_LINUX
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "InputModule.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+
+namespace framework
+{
+
+/// @brief Retained grayscale framebuffer for the LED Matrix
+///
+/// The frame is drawn locally with SetPixel / SetColumn / Fill and only sent to the device when Present is called.
+/// Present compares the new frame with what the device is known to display and ships the cheapest set of commands
+/// that gets it there:
+/// - nothing if the frame did not change
+/// - a single DrawBW if every pixel is either fully off or fully on and it is smaller than staging the columns
+/// - a StageCol for each column that differs from the device column buffer, followed by a FlushCol otherwise
+///
+/// Present can also be split in Stage and Flip, to display a frame on several devices at the same time
+class LEDMatrixFramebuffer
+{
+public:
+    static constexpr int Width = 9;
+    static constexpr int Height = 34;
+
+    using Column = std::array<uint8_t, Height>;
+    using Frame = std::array<Column, Width>;
+
+public:
+    /// @param Module The LED Matrix to draw on. The pointer is not owned and must outlive the framebuffer
+    explicit LEDMatrixFramebuffer(IInputModule* Module): Module(Module)
+    {
+    }
+
+    /// Set the brightness of one pixel
+    void SetPixel(int X, int Y, uint8_t Value)
+    {
+        INPUTMODULE_ASSERT(X >= 0 && X < Width && Y >= 0 && Y < Height);
+        Pixels[X][Y] = Value;
+    }
+
+    /// Get the brightness of one pixel
+    uint8_t GetPixel(int X, int Y) const
+    {
+        INPUTMODULE_ASSERT(X >= 0 && X < Width && Y >= 0 && Y < Height);
+        return Pixels[X][Y];
+    }
+
+    /// Replace a whole column, from top to bottom
+    void SetColumn(int X, const Column& Data)
+    {
+        INPUTMODULE_ASSERT(X >= 0 && X < Width);
+        Pixels[X] = Data;
+    }
+
+    /// Set every pixel of the frame to the same brightness
+    void Fill(uint8_t Value)
+    {
+        for (Column& Col: Pixels) {
+            Col.fill(Value);
+        }
+    }
+
+    const Frame& GetFrame() const
+    {
+        return Pixels;
+    }
+
+    /// Forget what the device is displaying, the next Present will redraw the whole frame
+    ///
+    /// Must be called when something else draws on the device (Pattern, Animate, another framebuffer, ...)
+    void Invalidate()
+    {
+        bDisplayedValid = false;
+        bStagedValid = false;
+        PendingMode = PresentMode::Unchanged;
+    }
+
+    /// Send the frame to the device
+    ///
+    /// @return The number of bytes written to the device (0 if the frame was already displayed), -1 on error.
+    /// On error the device state is unknown and the next Present redraws the whole frame
+    int Present()
+    {
+        if (Module == nullptr) {
+            return -1;
+        }
+
+        switch (GetPresentMode()) {
+            case PresentMode::Unchanged: return 0;
+            case PresentMode::BW: return FinishPresent(SendBW(Pixels), Pixels);
+            case PresentMode::Columns: return FinishPresent(SendColumns(true), Pixels);
+        }
+        return -1;
+    }
+
+    /// First half of Present: send the frame to the device without displaying it
+    ///
+    /// Flip must be called afterward to display the frame. This allows several devices to flip at the same time
+    /// @return The number of bytes written to the device, -1 on error
+    int Stage()
+    {
+        if (Module == nullptr) {
+            return -1;
+        }
+
+        PendingMode = GetPresentMode();
+        PendingFrame = Pixels;
+        // DrawBW is not staged, it is sent by Flip
+        if (PendingMode != PresentMode::Columns) {
+            return 0;
+        }
+
+        const int Written = SendColumns(false);
+        if (Written < 0) {
+            PendingMode = PresentMode::Unchanged;
+            Invalidate();
+        }
+        return Written;
+    }
+
+    /// Second half of Present: display the frame sent by Stage
+    ///
+    /// @return The number of bytes written to the device, -1 on error
+    int Flip()
+    {
+        if (Module == nullptr) {
+            return -1;
+        }
+
+        switch (std::exchange(PendingMode, PresentMode::Unchanged)) {
+            case PresentMode::Unchanged: return 0;
+            case PresentMode::BW: return FinishPresent(SendBW(PendingFrame), PendingFrame);
+            case PresentMode::Columns: {
+                const int Written = Module->WriteToDevice<Commands::FlushCol>();
+                if (Written >= 0) {
+                    ClearStaged();
+                }
+                return FinishPresent(Written, PendingFrame);
+            }
+        }
+        return -1;
+    }
+
+private:
+    enum class PresentMode {
+        Unchanged,    /// The device already displays the frame
+        BW,           /// Draw the frame at once with DrawBW
+        Columns,      /// Stage the columns that changed and flush them
+    };
+
+    PresentMode GetPresentMode() const
+    {
+        if (bDisplayedValid && Displayed == Pixels) {
+            return PresentMode::Unchanged;
+        }
+
+        int DirtyColumns = 0;
+        for (int X = 0; X < Width; X++) {
+            if (!IsColumnStaged(X)) {
+                DirtyColumns++;
+            }
+        }
+
+        // Batched commands are padded to a full packet, only the FlushCol closing the batch is not
+        const std::size_t StageSize =
+            DirtyColumns * std::max(sizeof(Commands::StageCol), IInputModule::PacketSize) + sizeof(Commands::FlushCol);
+        if (IsMonochrome() && sizeof(Commands::DrawBW) < StageSize) {
+            return PresentMode::BW;
+        }
+        return PresentMode::Columns;
+    }
+
+    int FinishPresent(int Written, const Frame& Presented)
+    {
+        if (Written < 0) {
+            Invalidate();
+            return -1;
+        }
+        Displayed = Presented;
+        bDisplayedValid = true;
+        return Written;
+    }
+
+    bool IsColumnStaged(int X) const
+    {
+        return bStagedValid && Staged[X] == Pixels[X];
+    }
+
+    /// DrawBW can only display pixels that are fully off or fully on
+    bool IsMonochrome() const
+    {
+        for (const Column& Col: Pixels) {
+            for (const uint8_t Value: Col) {
+                if (Value != 0x00 && Value != 0xFF) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    int SendBW(const Frame& Data)
+    {
+        // Pixels are packed row by row, least significant bit first
+        Commands::DrawBW Command;
+        for (int Y = 0; Y < Height; Y++) {
+            for (int X = 0; X < Width; X++) {
+                if (Data[X][Y] != 0) {
+                    const int Index = Y * Width + X;
+                    Command.Data[Index / 8] |= 1 << (Index % 8);
+                }
+            }
+        }
+        // DrawBW does not go through the column buffer, so whatever was staged is still there
+        return Module->WriteToDevice(Command);
+    }
+
+    /// Stage the columns that differ from the device column buffer
+    ///
+    /// @param bFlush Flush the column buffer right after, in the same system call
+    int SendColumns(bool bFlush)
+    {
+        Commands::StageCol StageCommands[Width];
+        const Commands::FlushCol FlushCommand;
+        std::array<std::span<const uint8_t>, Width + 1> Buffers;
+
+        std::size_t BufferCount = 0;
+        for (int X = 0; X < Width; X++) {
+            if (IsColumnStaged(X)) {
+                continue;
+            }
+            Commands::StageCol& Command = StageCommands[X];
+            Command.Col = static_cast<uint8_t>(X);
+            std::memcpy(Command.Data, Pixels[X].data(), Height);
+            Buffers[BufferCount++] = AsPayloadBytes(Command);
+        }
+        if (bFlush) {
+            Buffers[BufferCount++] = AsPayloadBytes(FlushCommand);
+        }
+        if (BufferCount == 0) {
+            return 0;
+        }
+
+        const int Written = Module->WriteBatchToDevice(std::span(Buffers.data(), BufferCount));
+        if (Written < 0) {
+            return -1;
+        }
+
+        Staged = Pixels;
+        bStagedValid = true;
+        if (bFlush) {
+            ClearStaged();
+        }
+        return Written;
+    }
+
+    /// The firmware clears its column buffer once it has been flushed
+    void ClearStaged()
+    {
+        for (Column& Col: Staged) {
+            Col.fill(0);
+        }
+        bStagedValid = true;
+    }
+
+private:
+    IInputModule* const Module = nullptr;
+
+    /// Frame being drawn
+    Frame Pixels = {};
+    /// Frame currently displayed by the device
+    Frame Displayed = {};
+    /// Content of the device column buffer
+    Frame Staged = {};
+    /// Frame sent by Stage, waiting for Flip
+    Frame PendingFrame = {};
+    PresentMode PendingMode = PresentMode::Unchanged;
+
+    bool bDisplayedValid = false;
+    bool bStagedValid = false;
+};
+
+}    // namespace framework
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "InputModule.hxx"
+#include "LEDMatrixFramebuffer.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace framework
+{
+
+/// @brief Single canvas spanning several LED Matrix, side by side
+///
+/// Each LED Matrix is driven by its own thread. When presenting a frame, every thread stages its columns at the same
+/// time and waits for them to be transmitted, then they all flip together. The time to present a frame is the time of
+/// the slowest LED Matrix, and every panel switches to the new frame at the same moment.
+class LEDMatrixVirtualDisplay
+{
+public:
+    static constexpr int Height = LEDMatrixFramebuffer::Height;
+
+public:
+    /// Span every LED Matrix of the manager, the first one on the left
+    explicit LEDMatrixVirtualDisplay(IInputModuleManager& Manager)
+        : LEDMatrixVirtualDisplay(GetLEDMatrices(Manager))
+    {
+    }
+
+    /// Span the given LED Matrix, from left to right
+    ///
+    /// @param Modules The LED Matrix to draw on. The pointers are not owned and must outlive the display
+    explicit LEDMatrixVirtualDisplay(std::span<IInputModule* const> Modules)
+        : FrameBarrier(static_cast<std::ptrdiff_t>(Modules.size() + 1))
+    {
+        Panels.reserve(Modules.size());
+        for (IInputModule* const Module: Modules) {
+            Panels.emplace_back(Module);
+        }
+
+        Workers.reserve(Panels.size());
+        for (std::size_t Index = 0; Index < Panels.size(); Index++) {
+            Workers.emplace_back([this, Index] { RunPanel(Panels[Index]); });
+        }
+    }
+
+    ~LEDMatrixVirtualDisplay()
+    {
+        bStopping.store(true, std::memory_order_release);
+        FrameBarrier.arrive_and_drop();
+    }
+
+    LEDMatrixVirtualDisplay(const LEDMatrixVirtualDisplay&) = delete;
+    LEDMatrixVirtualDisplay& operator=(const LEDMatrixVirtualDisplay&) = delete;
+
+    /// Number of LED Matrix spanned
+    int GetPanelCount() const
+    {
+        return static_cast<int>(Panels.size());
+    }
+
+    /// Width of the canvas, in pixels
+    int GetWidth() const
+    {
+        return GetPanelCount() * LEDMatrixFramebuffer::Width;
+    }
+
+    /// Set the brightness of one pixel
+    void SetPixel(int X, int Y, uint8_t Value)
+    {
+        INPUTMODULE_ASSERT(X >= 0 && X < GetWidth());
+        Panels[X / LEDMatrixFramebuffer::Width].Framebuffer.SetPixel(X % LEDMatrixFramebuffer::Width, Y, Value);
+    }
+
+    /// Get the brightness of one pixel
+    uint8_t GetPixel(int X, int Y) const
+    {
+        INPUTMODULE_ASSERT(X >= 0 && X < GetWidth());
+        return Panels[X / LEDMatrixFramebuffer::Width].Framebuffer.GetPixel(X % LEDMatrixFramebuffer::Width, Y);
+    }
+
+    /// Set every pixel of the canvas to the same brightness
+    void Fill(uint8_t Value)
+    {
+        for (Panel& Target: Panels) {
+            Target.Framebuffer.Fill(Value);
+        }
+    }
+
+    /// Forget what the devices are displaying, the next Present will redraw the whole canvas
+    void Invalidate()
+    {
+        for (Panel& Target: Panels) {
+            Target.Framebuffer.Invalidate();
+        }
+    }
+
+    /// Send the canvas to every LED Matrix and display it on all of them at once
+    ///
+    /// @return The number of bytes written to the devices, -1 if any of them failed. The panels that did not fail
+    /// still display the new frame
+    int Present()
+    {
+        // Start the frame, then wait for every panel to be staged and flipped
+        FrameBarrier.arrive_and_wait();
+        FrameBarrier.arrive_and_wait();
+        FrameBarrier.arrive_and_wait();
+
+        int Written = 0;
+        bool bFailed = false;
+        for (const Panel& Target: Panels) {
+            bFailed |= Target.Result < 0;
+            Written += std::max(Target.Result, 0);
+        }
+        return bFailed ? -1 : Written;
+    }
+
+private:
+    struct Panel {
+        explicit Panel(IInputModule* Module): Module(Module), Framebuffer(Module)
+        {
+        }
+
+        IInputModule* const Module = nullptr;
+        LEDMatrixFramebuffer Framebuffer;
+        /// Bytes written for the last frame, -1 on error
+        int Result = 0;
+    };
+
+    static std::vector<IInputModule*> GetLEDMatrices(IInputModuleManager& Manager)
+    {
+        std::vector<IInputModule*> Modules;
+        const int Count = Manager.IsTypeOfInputModuleAvailable(InputModuleType::LEDMatrix);
+        for (int Index = 0; Index < Count; Index++) {
+            if (IInputModule* const Module = Manager.GetInputModule(InputModuleType::LEDMatrix, Index)) {
+                Modules.push_back(Module);
+            }
+        }
+        return Modules;
+    }
+
+    void RunPanel(Panel& Target)
+    {
+        while (true) {
+            FrameBarrier.arrive_and_wait();
+            if (bStopping.load(std::memory_order_acquire)) {
+                FrameBarrier.arrive_and_drop();
+                return;
+            }
+
+            // Columns still in flight would be flushed late, wait for them before flipping
+            const int Staged = Target.Framebuffer.Stage();
+            const bool bTransmitted = Staged > 0 ? Target.Module->WaitForTransmission() : Staged == 0;
+            FrameBarrier.arrive_and_wait();
+
+            const int Flipped = Target.Framebuffer.Flip();
+            Target.Result = (bTransmitted && Flipped >= 0) ? Staged + Flipped : -1;
+            FrameBarrier.arrive_and_wait();
+        }
+    }
+
+private:
+    std::vector<Panel> Panels;
+
+    /// Every worker and the presenting thread meet three times per frame: start, staged and flipped
+    std::barrier<> FrameBarrier;
+    std::atomic<bool> bStopping = false;
+
+    /// Declared last so they are joined before anything else is destroyed
+    std::vector<std::jthread> Workers;
+};
+
+}    // namespace framework
@@ -0,0 +1,654 @@
+#include "B1DisplayFramebuffer.hxx"
+#include "ImageConversion.hxx"
+#include "InputModuleEmulator.hxx"
+#include "InputModuleReactor.hxx"
+#include "LEDMatrixFramebuffer.hxx"
+#include "LEDMatrixVirtualDisplay.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+struct BenchmarkResult {
+    BenchmarkResult(std::string_view Name, std::size_t Operations): Name(Name), Operations(Operations)
+    {
+    }
+
+    /// Report that the library did not behave as expected
+    void Fail(std::string_view Reason)
+    {
+        std::cerr << Name << ": " << Reason << std::endl;
+        Failures++;
+    }
+
+    std::string_view Name;
+    std::size_t Operations = 0;
+    uint64_t Bytes = 0;
+    Clock::duration Duration = {};
+    /// Round-trip latency of every operation, empty when not measured
+    std::vector<Clock::duration> Latencies;
+    /// Number of checks that failed
+    std::size_t Failures = 0;
+};
+
+void PrintResult(BenchmarkResult& Result)
+{
+    const double Seconds = std::chrono::duration<double>(Result.Duration).count();
+
+    std::cout << std::left << std::setw(24) << Result.Name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << Result.Operations / Seconds << " op/s" << std::setw(14) << Result.Bytes / Seconds
+              << " B/s";
+
+    if (!Result.Latencies.empty()) {
+        std::sort(Result.Latencies.begin(), Result.Latencies.end());
+        const auto Percentile = [&Result](double Ratio) {
+            const std::size_t Index =
+                std::min(Result.Latencies.size() - 1, std::size_t(Result.Latencies.size() * Ratio));
+            return std::chrono::duration<double, std::micro>(Result.Latencies[Index]).count();
+        };
+        std::cout << std::setprecision(1) << std::setw(10) << Percentile(0.50) << " us p50" << std::setw(10)
+                  << Percentile(0.99) << " us p99";
+    }
+    std::cout << std::endl;
+}
+
+/// Wait for the emulator to have handled every command sent to it
+bool WaitForFirmware(const framework::InputModuleEmulated& Module, uint64_t CommandCount)
+{
+    const Clock::time_point Deadline = Clock::now() + 30s;
+    while (Module.GetFirmware().GetCommandCount() < CommandCount) {
+        if (Clock::now() > Deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+BenchmarkResult BenchmarkCommands(framework::InputModuleEmulated& Module, std::size_t Count)
+{
+    using namespace framework;
+
+    BenchmarkResult Result("Brightness", Count);
+    const uint64_t FirstCommand = Module.GetFirmware().GetCommandCount();
+    const uint64_t FirstByte = Module.GetFirmware().GetReceivedBytes();
+
+    const Clock::time_point Start = Clock::now();
+    for (std::size_t Index = 0; Index < Count; Index++) {
+        Module.WriteToDevice(CommandType::Brightness, static_cast<uint8_t>(Index));
+    }
+    if (!WaitForFirmware(Module, FirstCommand + Count)) {
+        Result.Fail("the emulator did not handle every command in time");
+    } else if (Module.GetFirmware().GetBrightness() != static_cast<uint8_t>(Count - 1)) {
+        Result.Fail("the emulator does not have the last brightness");
+    }
+    Result.Duration = Clock::now() - Start;
+    Result.Bytes = Module.GetFirmware().GetReceivedBytes() - FirstByte;
+    return Result;
+}
+
+BenchmarkResult BenchmarkRoundTrip(framework::InputModuleEmulated& Module, std::size_t Count)
+{
+    using namespace framework;
+
+    BenchmarkResult Result("Version round-trip", Count);
+    Result.Latencies.reserve(Count);
+    const uint64_t FirstByte = Module.GetFirmware().GetReceivedBytes();
+
+    const Clock::time_point Start = Clock::now();
+    for (std::size_t Index = 0; Index < Count; Index++) {
+        const Clock::time_point RequestStart = Clock::now();
+        const Commands::Version::Reply Reply = Module.WriteToDevice<Commands::Version>();
+        Result.Latencies.push_back(Clock::now() - RequestStart);
+
+        if (Reply.ToString() != InputModuleFirmwareEmulator::Version.ToString()) {
+            Result.Fail("unexpected version " + Reply.ToString());
+        }
+    }
+    Result.Duration = Clock::now() - Start;
+    Result.Bytes = Module.GetFirmware().GetReceivedBytes() - FirstByte + Count * IInputModule::ReplySize;
+    return Result;
+}
+
+/// Version round-trips driven by the reactor, without a thread blocking on the device
+BenchmarkResult BenchmarkReactor(framework::InputModuleEmulated& Module, std::size_t Count)
+{
+    using namespace framework;
+
+    BenchmarkResult Result("Reactor round-trip", Count);
+    Result.Latencies.reserve(Count);
+    const uint64_t FirstByte = Module.GetFirmware().GetReceivedBytes();
+
+    InputModuleReactor Reactor;
+    InputModuleReactorDevice* const Device = Reactor.Attach(Module);
+    if (Device == nullptr) {
+        Result.Fail("failed to attach the emulated input module to the reactor");
+        return Result;
+    }
+
+    const auto Task = [](InputModuleReactorDevice* Device, BenchmarkResult& Result) -> InputModuleTask {
+        for (std::size_t Index = 0; Index < Result.Operations; Index++) {
+            const Clock::time_point RequestStart = Clock::now();
+            const std::optional<Commands::Version::Reply> Reply = co_await Device->Send<Commands::Version>();
+            Result.Latencies.push_back(Clock::now() - RequestStart);
+
+            if (!Reply || Reply->ToString() != InputModuleFirmwareEmulator::Version.ToString()) {
+                Result.Fail("unexpected version from the reactor");
+            }
+        }
+    };
+
+    const Clock::time_point Start = Clock::now();
+    Reactor.Spawn(Task(Device, Result));
+    Reactor.Run();
+    Result.Duration = Clock::now() - Start;
+    Result.Bytes = Module.GetFirmware().GetReceivedBytes() - FirstByte + Count * IInputModule::ReplySize;
+    return Result;
+}
+
+/// Stream frames with a moving gradient, so most columns change every frame, each one until the emulator shows it
+BenchmarkResult BenchmarkFrames(framework::InputModuleEmulated& Module, std::size_t Count)
+{
+    using namespace framework;
+
+    BenchmarkResult Result("Framebuffer frames", Count);
+    Result.Latencies.reserve(Count);
+    const uint64_t FirstByte = Module.GetFirmware().GetReceivedBytes();
+
+    LEDMatrixFramebuffer Framebuffer(&Module);
+    const Clock::time_point Start = Clock::now();
+    for (std::size_t Frame = 0; Frame < Count; Frame++) {
+        for (int X = 0; X < LEDMatrixFramebuffer::Width; X++) {
+            for (int Y = 0; Y < LEDMatrixFramebuffer::Height; Y++) {
+                Framebuffer.SetPixel(X, Y, static_cast<uint8_t>((Frame + X * 7 + Y * 3) * 4));
+            }
+        }
+
+        const Clock::time_point FrameStart = Clock::now();
+        Framebuffer.Present();
+        // The emulator handles commands in order, so the frame is displayed once the reply is back
+        if (Module.WriteToDevice<Commands::Version>().ToString() != InputModuleFirmwareEmulator::Version.ToString()) {
+            Result.Fail("unexpected version");
+        }
+        Result.Latencies.push_back(Clock::now() - FrameStart);
+    }
+    Result.Duration = Clock::now() - Start;
+    Result.Bytes = Module.GetFirmware().GetReceivedBytes() - FirstByte + Count * IInputModule::ReplySize;
+
+    const InputModuleFirmwareEmulator::LEDMatrixGrid Grid = Module.GetFirmware().GetGrid();
+    if (std::memcmp(Grid.data(), Framebuffer.GetFrame().data(), sizeof(Grid)) != 0) {
+        Result.Fail("the emulator does not display the last frame");
+    }
+    return Result;
+}
+
+/// Bursts of commands through the asynchronous queue, with commands with a reply in between acting as barriers
+BenchmarkResult CheckAsyncQueue(framework::InputModuleEmulated& Module)
+{
+    using namespace framework;
+
+    constexpr int BurstSize = 50;
+    BenchmarkResult Result("Async queue", 0);
+    InputModuleAsyncQueue* const Queue = Module.GetAsyncQueue();
+    if (Queue == nullptr) {
+        Result.Fail("no asynchronous queue");
+        return Result;
+    }
+    const uint64_t FirstCommand = Module.GetFirmware().GetCommandCount();
+    const uint64_t FirstByte = Module.GetFirmware().GetReceivedBytes();
+
+    const Clock::time_point Start = Clock::now();
+    std::size_t Submitted = 0;
+    for (int Index = 1; Index <= BurstSize; Index++) {
+        Submitted += Queue->Submit(CommandType::Brightness, Index);
+        Submitted += Queue->Submit(CommandType::Pattern, static_cast<uint8_t>(PatternType::Percentage), Index);
+    }
+    std::future<Commands::Version::Reply> Version = Queue->Submit<Commands::Version>();
+    std::future<Commands::GetBrightness::Reply> Brightness = Queue->Submit<Commands::GetBrightness>();
+    for (int Index = BurstSize + 1; Index <= BurstSize * 2; Index++) {
+        Submitted += Queue->Submit(CommandType::Brightness, Index);
+    }
+    Submitted += Queue->Submit(CommandType::Pattern, static_cast<uint8_t>(PatternType::ZigZag));
+    Queue->Flush();
+    Result.Duration = Clock::now() - Start;
+
+    // The emulator handles commands in order, so every command has been handled once the last reply is back
+    std::future<Commands::Version::Reply> LastVersion = Queue->Submit<Commands::Version>();
+    Submitted += 3;
+    Result.Operations = Submitted;
+    if (LastVersion.get().ToString() != InputModuleFirmwareEmulator::Version.ToString()) {
+        Result.Fail("unexpected version");
+    }
+    const uint64_t Handled = Module.GetFirmware().GetCommandCount() - FirstCommand;
+    Result.Bytes = Module.GetFirmware().GetReceivedBytes() - FirstByte + 3 * IInputModule::ReplySize;
+
+    if (Submitted != BurstSize * 3 + 4) {
+        Result.Fail("the queue was full");
+    }
+    if (Version.get().ToString() != InputModuleFirmwareEmulator::Version.ToString()) {
+        Result.Fail("unexpected version");
+    }
+    if (Brightness.get().Brightness != BurstSize) {
+        Result.Fail("the brightness read is not the one of the last command before it");
+    }
+    if (Module.GetFirmware().GetBrightness() != BurstSize * 2 ||
+        Module.GetFirmware().GetPattern() != PatternType::ZigZag) {
+        Result.Fail("the emulator does not have the last brightness and pattern");
+    }
+    // At least the last Brightness and Pattern on each side of the barrier, and the three replies
+    if (Handled < 7 || Handled > Submitted) {
+        Result.Fail("unexpected number of commands handled by the emulator");
+    }
+    return Result;
+}
+
+/// Commands to a device that never reads them time out instead of hanging
+BenchmarkResult CheckTimeouts()
+{
+    using namespace framework;
+
+    BenchmarkResult Result("Timeouts", 2);
+    termios TTYSettings = {};
+    cfmakeraw(&TTYSettings);
+    int MasterFD = -1;
+    int SlaveFD = -1;
+    if (openpty(&MasterFD, &SlaveFD, nullptr, &TTYSettings, nullptr) != 0) {
+        Result.Fail("failed to open a terminal");
+        return Result;
+    }
+    fcntl(MasterFD, F_SETFL, fcntl(MasterFD, F_GETFL) | O_NONBLOCK);
+
+    // The master is never read while the commands are sent, so no reply comes back and the buffers fill up
+    constexpr std::chrono::milliseconds Timeout = 100ms;
+    InputModuleLinux Wedged(InputModuleType::LEDMatrix, SlaveFD);
+    Wedged.SetTimeout(Timeout);
+    const Clock::time_point Start = Clock::now();
+
+    Clock::time_point RequestStart = Clock::now();
+    const Commands::Version::Reply BlockingReply = Wedged.WriteToDevice<Commands::Version>();
+    if (Clock::now() - RequestStart > 10 * Timeout) {
+        Result.Fail("a blocking command without a reply did not time out");
+    }
+    if (BlockingReply.ToString() == InputModuleFirmwareEmulator::Version.ToString()) {
+        Result.Fail("a blocking command without a reply got a version");
+    }
+
+    InputModuleReactor Reactor;
+    InputModuleReactorDevice* const Device = Reactor.Attach(Wedged);
+    if (Device == nullptr) {
+        Result.Fail("failed to attach the terminal to the reactor");
+    } else {
+        const auto Task = [](InputModuleReactorDevice* Device, BenchmarkResult& Result) -> InputModuleTask {
+            if (co_await Device->Send<Commands::Version>()) {
+                Result.Fail("a reactor command without a reply resolved to a version");
+            }
+        };
+        RequestStart = Clock::now();
+        Reactor.Spawn(Task(Device, Result));
+        Reactor.Run();
+        if (Clock::now() - RequestStart > 10 * Timeout) {
+            Result.Fail("a reactor command without a reply did not time out");
+        }
+    }
+
+    // Fill the terminal until a command without a reply times out too
+    std::size_t Sent = 0;
+    while (Sent < 1024 && Wedged.WriteToDevice(Commands::DrawBW{}) > 0) {
+        Sent++;
+    }
+    if (Sent == 1024) {
+        Result.Fail("the terminal never filled up");
+    }
+    Result.Bytes = Sent * sizeof(Commands::DrawBW);
+
+    close(MasterFD);
+    Result.Duration = Clock::now() - Start;
+    return Result;
+}
+
+/// Present grayscale then monochrome frames on a canvas spanning two LED Matrix, and compare what each one displays
+BenchmarkResult CheckVirtualDisplay()
+{
+    using namespace framework;
+
+    constexpr int FrameCount = 8;
+    BenchmarkResult Result("Virtual display", FrameCount);
+    InputModuleEmulated Left(InputModuleType::LEDMatrix);
+    InputModuleEmulated Right(InputModuleType::LEDMatrix);
+    if (!Left.IsValid() || !Left.GetFirmware().IsValid() || !Right.IsValid() || !Right.GetFirmware().IsValid()) {
+        Result.Fail("failed to create the emulated input modules");
+        return Result;
+    }
+    const std::array<IInputModule*, 2> Modules = {&Left, &Right};
+
+    const auto IsDisplayed = [](const LEDMatrixVirtualDisplay& Display, int Panel, InputModuleEmulated& Module) {
+        // The emulator handles commands in order, so the frame is displayed once the reply is back
+        Module.WriteToDevice<Commands::Version>();
+        const InputModuleFirmwareEmulator::LEDMatrixGrid Grid = Module.GetFirmware().GetGrid();
+        for (int X = 0; X < LEDMatrixFramebuffer::Width; X++) {
+            for (int Y = 0; Y < LEDMatrixVirtualDisplay::Height; Y++) {
+                if (Grid[X][Y] != Display.GetPixel(Panel * LEDMatrixFramebuffer::Width + X, Y)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    // Destroying the display stops its threads, which must not hang
+    LEDMatrixVirtualDisplay Display(Modules);
+    const Clock::time_point Start = Clock::now();
+    for (int Frame = 0; Frame < FrameCount; Frame++) {
+        const bool bMonochrome = Frame >= FrameCount / 2;
+        for (int X = 0; X < Display.GetWidth(); X++) {
+            for (int Y = 0; Y < LEDMatrixVirtualDisplay::Height; Y++) {
+                const uint8_t Value = static_cast<uint8_t>((Frame + X * 7 + Y * 3) * 4);
+                Display.SetPixel(X, Y, bMonochrome ? (Value & 0x80 ? 0xFF : 0x00) : Value);
+            }
+        }
+
+        const int Written = Display.Present();
+        if (Written <= 0) {
+            Result.Fail("failed to present frame " + std::to_string(Frame));
+            continue;
+        }
+        Result.Bytes += Written;
+        if (!IsDisplayed(Display, 0, Left) || !IsDisplayed(Display, 1, Right)) {
+            Result.Fail("the emulators do not display frame " + std::to_string(Frame));
+        }
+    }
+
+    if (Display.Present() != 0) {
+        Result.Fail("an unchanged frame was sent again");
+    }
+    Result.Duration = Clock::now() - Start;
+    return Result;
+}
+
+/// Redraw a whole B1 Display, then a single column, and compare what the emulator displays
+BenchmarkResult CheckB1Display()
+{
+    using namespace framework;
+
+    BenchmarkResult Result("B1 Display", 2);
+    InputModuleEmulated Module(InputModuleType::B1Display);
+    if (!Module.IsValid() || !Module.GetFirmware().IsValid()) {
+        Result.Fail("failed to create the emulated input module");
+        return Result;
+    }
+    B1DisplayFramebuffer Framebuffer(&Module);
+
+    // The emulator handles commands in order, so every command before the version has been handled once it is back
+    const auto CountCommands = [&Module](uint64_t FirstCommand) {
+        Module.WriteToDevice<Commands::Version>();
+        return Module.GetFirmware().GetCommandCount() - FirstCommand - 1;
+    };
+    const auto IsDisplayed = [&Module, &Framebuffer] {
+        for (int X = 0; X < B1DisplayFramebuffer::Width; X++) {
+            for (int Y = 0; Y < B1DisplayFramebuffer::Height; Y++) {
+                if (Module.GetFirmware().GetB1Pixel(X, Y) != Framebuffer.GetPixel(X, Y)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    // Every column changes, in batches of 32 commands
+    for (int X = 0; X < B1DisplayFramebuffer::Width; X++) {
+        Framebuffer.SetPixel(X, (X * 7) % B1DisplayFramebuffer::Height, true);
+    }
+    uint64_t FirstCommand = Module.GetFirmware().GetCommandCount();
+    const Clock::time_point Start = Clock::now();
+    const int FullWritten = Framebuffer.Present();
+    if (FullWritten < 0 || CountCommands(FirstCommand) != B1DisplayFramebuffer::Width + 1) {
+        Result.Fail("the full redraw is not one SetPxColor per column and a FlushFB");
+    }
+    if (!IsDisplayed()) {
+        Result.Fail("the emulator does not display the full redraw");
+    }
+
+    // A single column changes, padded to a packet before the FlushFB
+    Framebuffer.SetPixel(123, 321, true);
+    FirstCommand = Module.GetFirmware().GetCommandCount();
+    const int DeltaWritten = Framebuffer.Present();
+    if (DeltaWritten != static_cast<int>(IInputModule::PacketSize + sizeof(Commands::FlushFB)) ||
+        CountCommands(FirstCommand) != 2) {
+        Result.Fail("the single column change is not a SetPxColor and a FlushFB");
+    }
+    if (!IsDisplayed()) {
+        Result.Fail("the emulator does not display the single column change");
+    }
+    Result.Duration = Clock::now() - Start;
+    Result.Bytes = FullWritten + DeltaWritten;
+
+    if (Framebuffer.Present() != 0) {
+        Result.Fail("an unchanged frame is sent again");
+    }
+    return Result;
+}
+
+/// Convert a 640x480 RGBA frame to the payloads of the LED Matrix, without any device
+BenchmarkResult BenchmarkConversion(std::size_t Count)
+{
+    using namespace framework;
+
+    constexpr int ImageWidth = 640;
+    constexpr int ImageHeight = 480;
+    std::vector<uint8_t> Pixels(ImageWidth * ImageHeight * 4);
+    for (std::size_t Index = 0; Index < Pixels.size(); Index++) {
+        Pixels[Index] = static_cast<uint8_t>(Index * 13 / 7);
+    }
+    const ImageView Image{
+        .Data = Pixels.data(),
+        .Width = ImageWidth,
+        .Height = ImageHeight,
+        .Stride = ImageWidth * 4,
+        .Format = PixelFormat::RGBA8,
+    };
+
+    BenchmarkResult Result("Image conversion", Count);
+    Result.Latencies.reserve(Count);
+
+    const ImageConverter Converter({.Dither = DitherMode::ErrorDiffusion});
+    Commands::DrawBW DrawCommand;
+    Commands::StageCol StageCommands[ImageConverter::Width];
+    const Clock::time_point Start = Clock::now();
+    for (std::size_t Frame = 0; Frame < Count; Frame++) {
+        const Clock::time_point FrameStart = Clock::now();
+        Converter.ToDrawBW(Image, DrawCommand);
+        Converter.ToStageCols(Image, StageCommands);
+        Result.Latencies.push_back(Clock::now() - FrameStart);
+    }
+    Result.Duration = Clock::now() - Start;
+    Result.Bytes = Count * Pixels.size() * 2;
+    return Result;
+}
+
+/// Compare the vectorized luma sums with a scalar reference, over sizes covering the vector tails
+BenchmarkResult CheckImageConversion()
+{
+    using namespace framework;
+
+    BenchmarkResult Result("Image conversion check", 0);
+    std::mt19937 Random(42);
+    const ImageConverter Converter({.Gamma = 1.0f});
+
+    const Clock::time_point Start = Clock::now();
+    for (const int ImageWidth: {1, 5, 9, 17, 33, 100, 641}) {
+        for (const int ImageHeight: {1, 20, 34, 35, 480}) {
+            for (const PixelFormat Format: {PixelFormat::Gray8, PixelFormat::RGBA8}) {
+                const int BytesPerPixel = Format == PixelFormat::RGBA8 ? 4 : 1;
+                // Rows do not start on a vector boundary
+                const std::size_t Stride = ImageWidth * BytesPerPixel + 3;
+                std::vector<uint8_t> Pixels(Stride * ImageHeight);
+                for (uint8_t& Value: Pixels) {
+                    Value = static_cast<uint8_t>(Random());
+                }
+
+                Commands::StageCol Columns[ImageConverter::Width];
+                Converter.ToStageCols(ImageView{Pixels.data(), ImageWidth, ImageHeight, Stride, Format}, Columns);
+                Result.Operations++;
+                Result.Bytes += Pixels.size();
+
+                for (int X = 0; X < ImageConverter::Width; X++) {
+                    const int Left = X * ImageWidth / ImageConverter::Width;
+                    const int Right = std::max(Left + 1, (X + 1) * ImageWidth / ImageConverter::Width);
+                    for (int Y = 0; Y < ImageConverter::Height; Y++) {
+                        const int Top = Y * ImageHeight / ImageConverter::Height;
+                        const int Bottom = std::max(Top + 1, (Y + 1) * ImageHeight / ImageConverter::Height);
+
+                        uint64_t Sum = 0;
+                        for (int Row = Top; Row < Bottom; Row++) {
+                            for (int Col = Left; Col < Right; Col++) {
+                                const uint8_t* const Pixel = &Pixels[Row * Stride + Col * BytesPerPixel];
+                                Sum += BytesPerPixel == 4 ? 77 * Pixel[0] + 150 * Pixel[1] + 29 * Pixel[2]
+                                                          : Pixel[0] * 256;
+                            }
+                        }
+                        const uint64_t Count = uint64_t(Right - Left) * (Bottom - Top);
+                        if (Columns[X].Data[Y] != (Sum + Count * 128) / (Count * 256)) {
+                            Result.Fail("the luma of a " + std::to_string(ImageWidth) + "x" +
+                                        std::to_string(ImageHeight) + " image does not match the reference");
+                            return Result;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    Result.Duration = Clock::now() - Start;
+
+    if (RawFrameFile("/dev/null", 0, 34, PixelFormat::Gray8).GetFrameCount() != 0 ||
+        RawFrameFile("/dev/null", 9, -1, PixelFormat::Gray8).IsValid()) {
+        Result.Fail("a raw frame file without pixels is valid");
+    }
+    return Result;
+}
+
+/// Check the curve and the black and white encodings on uniform images, whose result is known
+BenchmarkResult CheckImageEncoding()
+{
+    using namespace framework;
+
+    BenchmarkResult Result("Image encoding check", 0);
+    constexpr int ImageWidth = 20;
+    constexpr int ImageHeight = 50;
+    std::vector<uint8_t> Pixels(ImageWidth * ImageHeight);
+    const ImageView Image{Pixels.data(), ImageWidth, ImageHeight, ImageWidth, PixelFormat::Gray8};
+
+    const auto CountLit = [&Result](const Commands::DrawBW& Command) {
+        int Count = 0;
+        for (const uint8_t Byte: Command.Data) {
+            Count += std::popcount(Byte);
+        }
+        Result.Operations++;
+        return Count;
+    };
+    const auto ToColumns = [&Image, &Result](const ImageConverter& Converter) {
+        std::array<Commands::StageCol, ImageConverter::Width> Columns;
+        Converter.ToStageCols(Image, Columns);
+        Result.Operations++;
+        return Columns[ImageConverter::Width / 2].Data[ImageConverter::Height / 2];
+    };
+
+    const Clock::time_point Start = Clock::now();
+    constexpr int LEDCount = ImageConverter::Width * ImageConverter::Height;
+    for (const DitherMode Dither: {DitherMode::None, DitherMode::Ordered, DitherMode::ErrorDiffusion}) {
+        const ImageConverter Converter({.Gamma = 1.0f, .Dither = Dither});
+        Commands::DrawBW Command;
+
+        std::fill(Pixels.begin(), Pixels.end(), 0);
+        Converter.ToDrawBW(Image, Command);
+        if (CountLit(Command) != 0) {
+            Result.Fail("a black image lights LED up");
+        }
+
+        // The bits past the last LED stay clear
+        std::fill(Pixels.begin(), Pixels.end(), 255);
+        Converter.ToDrawBW(Image, Command);
+        if (CountLit(Command) != LEDCount || Command.Data[LEDCount / 8] != (1 << (LEDCount % 8)) - 1) {
+            Result.Fail("a white image does not light every LED up");
+        }
+
+        if (Dither == DitherMode::None) {
+            continue;
+        }
+        std::fill(Pixels.begin(), Pixels.end(), 128);
+        Converter.ToDrawBW(Image, Command);
+        const int Lit = CountLit(Command);
+        if (Lit < LEDCount * 2 / 5 || Lit > LEDCount * 3 / 5) {
+            Result.Fail("a gray image dithered does not light half of the LED up, but " + std::to_string(Lit));
+        }
+    }
+
+    // 255 * (128 / 255) ^ 2.2 rounds to 56
+    std::fill(Pixels.begin(), Pixels.end(), 128);
+    if (ToColumns(ImageConverter({.Gamma = 2.2f})) != 56) {
+        Result.Fail("the gamma curve does not match");
+    }
+    std::fill(Pixels.begin(), Pixels.end(), 200);
+    if (ToColumns(ImageConverter({.Gamma = 1.0f, .Brightness = 0.5f})) != 100 ||
+        ToColumns(ImageConverter({.Gamma = 1.0f, .Brightness = 2.0f})) != 255) {
+        Result.Fail("the brightness curve does not match");
+    }
+    Result.Duration = Clock::now() - Start;
+    Result.Bytes = Result.Operations * Pixels.size();
+    return Result;
+}
+
+int main(int ac, char** av)
+{
+    // --baud slows the emulator down to a 115200 bauds serial link
+    const bool bSimulateBaudRate = ac > 1 && std::string_view(av[1]) == "--baud";
+    const std::size_t Scale = bSimulateBaudRate ? 1 : 20;
+
+    framework::InputModuleEmulated Module(framework::InputModuleType::LEDMatrix, bSimulateBaudRate);
+    if (!Module.IsValid() || !Module.GetFirmware().IsValid()) {
+        std::cerr << "Failed to create the emulated input module" << std::endl;
+        return 1;
+    }
+    // Commands without a reply are sent faster than a 115200 bauds link carries them, replies wait behind the backlog
+    Module.SetTimeout(30s);
+
+    std::vector<BenchmarkResult> Results;
+    Results.push_back(BenchmarkCommands(Module, 500 * Scale));
+    Results.push_back(BenchmarkRoundTrip(Module, 100 * Scale));
+    Results.push_back(BenchmarkReactor(Module, 100 * Scale));
+    Results.push_back(BenchmarkFrames(Module, 50 * Scale));
+    Results.push_back(CheckAsyncQueue(Module));
+    Results.push_back(CheckTimeouts());
+    Results.push_back(CheckVirtualDisplay());
+    Results.push_back(CheckB1Display());
+    Results.push_back(BenchmarkConversion(50 * Scale));
+    Results.push_back(CheckImageConversion());
+    Results.push_back(CheckImageEncoding());
+
+    std::size_t Failures = 0;
+    for (BenchmarkResult& Result: Results) {
+        PrintResult(Result);
+        Failures += Result.Failures;
+    }
+    std::cout << Module.GetStats().ToString();
+
+    if (Failures > 0) {
+        std::cerr << Failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}